@@ -1,16 +1,40 @@
 #pragma once
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
 
 #include "ArcLfu.h"
 #include "ArcLru.h"
+#include "CacheStats.h"
+#include "Executor.h"
+#include "Hasher.h"
 #include "LRUCache.h"
+#include "ReadBuffer.h"
+#include "Snapshot.h"
+#include "TimerWheel.h"
 
 template <typename Key, typename Value>
 class ArcCache : public MeltiCache::ICachePolicy<Key, Value>
 {
   public:
+    using Weigher = MeltiCache::Weigher<Key, Value>;
+    using Duration = MeltiCache::TimerWheel::Duration;
+    using LoadFunction = std::function<Value(const Key&)>;
+
     ArcCache(size_t capacity, size_t transformNeed)
         : capacity_(capacity),
           transformNeed_(transformNeed),
@@ -19,65 +43,808 @@ class ArcCache : public MeltiCache::ICachePolicy<Key, Value>
 
     {
     }
-    void put(Key key, Value value) override
+
+    // Weight-budgeted ARC: capacity is a budget in the weigher's units (e.g. bytes) for each of the LRU and
+    // LFU parts, and ghost hits move budget between them by the weight of the entry being inserted.
+    ArcCache(size_t capacity, size_t transformNeed, Weigher weigher)
+        : capacity_(capacity),
+          transformNeed_(transformNeed),
+          weigher_(std::move(weigher)),
+          lru(std::make_unique<ArcLru<Key, Value>>(capacity, transformNeed, true)),
+          lfu(std::make_unique<ArcLfu<Key, Value>>(capacity, true))
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        // if key in the lru ghost, lfu decrease capacity, lru increase capacity
-        // if key not in the lru ghost
-        bool isGhost = checkGhostCaches(key);
-        if (lfu->countain(key) || isGhost)
+    }
+
+    // Warm start: the configured cache, filled from a file written by snapshot(); a missing or damaged file
+    // leaves it (partly) empty, see load().
+    ArcCache(size_t capacity, size_t transformNeed, const std::string& snapshotPath)
+        : ArcCache(capacity, transformNeed)
+    {
+        load(snapshotPath);
+    }
+
+    // background reloads hold a pointer to the cache: wait for the scheduled ones to finish
+    ~ArcCache() override
+    {
+        std::unique_lock<std::mutex> lock(refreshMutex_);
+        refreshDone_.wait(lock, [this]() { return refreshing_.empty(); });
+    }
+
+    void put(const Key& key, const Value& value) override { ArcCache::putWithHash(key, hashOf(key), value); }
+
+    // The key is hashed once, outside the lock, and the hash serves both parts' index probes, the ghost
+    // lookups and the node (so eviction and ghost insertion do not rehash).
+    void putWithHash(const Key& key, uint64_t hash, const Value& value) override
+    {
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        drainReadBuffer();
+        putEntry(key, value, hash, 0);
+    }
+
+    void put(Key&& key, Value&& value) override
+    {
+        uint64_t hash = hashOf(key);
+        ArcCache::putWithHash(std::move(key), hash, std::move(value));
+    }
+
+    void putWithHash(Key&& key, uint64_t hash, Value&& value) override
+    {
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        drainReadBuffer();
+        putEntry(std::move(key), std::move(value), hash, 0);
+    }
+
+    // per-entry time to live, overrides the configured default
+    void put(const Key& key, const Value& value, Duration ttl) { putWithHash(key, hashOf(key), value, ttl); }
+
+    void put(Key&& key, Value&& value, Duration ttl)
+    {
+        uint64_t hash = hashOf(key);
+        putWithHash(std::move(key), hash, std::move(value), ttl);
+    }
+
+    void putWithHash(const Key& key, uint64_t hash, const Value& value, Duration ttl)
+    {
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        expiring_ = true;
+        drainReadBuffer();
+        putEntry(key, value, hash, toNanos(ttl));
+    }
+
+    void putWithHash(Key&& key, uint64_t hash, Value&& value, Duration ttl)
+    {
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        expiring_ = true;
+        drainReadBuffer();
+        putEntry(std::move(key), std::move(value), hash, toNanos(ttl));
+    }
+
+    // Entries expire ttl after they were written. Once any expiry is configured every operation reads the
+    // clock once; until then the cache never touches it.
+    void setExpireAfterWrite(Duration ttl)
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        expireAfterWrite_ = toNanos(ttl);
+        expiring_ = true;
+    }
+
+    // Entries expire ttl after their last read or write. Reads are replayed from the read buffer, so the
+    // deadline is pushed from the time of the next drain, which is never earlier than the read itself.
+    void setExpireAfterAccess(Duration ttl)
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        expireAfterAccess_ = toNanos(ttl);
+        expiring_ = true;
+    }
+
+    // The loader and executor behind refresh-ahead and co_get(). Configure before the cache is shared; the
+    // executor must outlive the cache.
+    void setLoader(LoadFunction loader, MeltiCache::Executor& executor)
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        loader_ = std::move(loader);
+        executor_ = &executor;
+    }
+
+    // Stale-while-revalidate: a hit on an entry written more than age ago still returns the current value at
+    // once and schedules a reload through the loader on the executor, at most one per key in flight. The
+    // reload replaces the value (with the default time to live) only if the entry has not been rewritten,
+    // evicted or expired meanwhile; a failed reload leaves the old value and the next stale hit tries again.
+    // Needs setLoader(); age 0 turns it off.
+    void setRefreshAfterWrite(Duration age)
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        refreshAfter_ = toNanos(age);
+    }
+
+    // Maintenance: replays buffered reads and reclaims every expired entry in one pass over the due wheel
+    // buckets. Writes do the same on their way in.
+    void cleanUp()
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        drainReadBuffer();
+        if (expiring_) expireEntries(MeltiCache::TimerWheel::now());
+    }
+
+    // Ghost hits and expired entries count as absent: the insert still adapts the LRU/LFU split like a put.
+    bool insertIfAbsent(const Key& key, const std::function<Value()>& makeValue) override
+    {
+        return ArcCache::insertIfAbsentWithHash(key, hashOf(key), makeValue);
+    }
+
+    bool insertIfAbsentWithHash(const Key& key, uint64_t hash, const std::function<Value()>& makeValue) override
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        drainReadBuffer();
+        uint64_t now = clock();
+        Slot slot;
+        if (lru->find(key, hash, slot) && !(expiring_ && lru->expired(slot, now))) return false;
+        if (lfu->find(key, hash, slot) && !(expiring_ && lfu->expired(slot, now))) return false;
+        putEntry(key, makeValue(), hash, 0, now);
+        return true;
+    }
+
+    // Hits only take the shared lock: the value is copied out and the access is appended to the read
+    // buffer. LRU moves, LFU frequency bumps and LRU -> LFU promotion are applied later in a batch by
+    // whoever next holds the exclusive lock (a put, or a reader that found its buffer stripe full).
+    bool get(const Key& key, Value& value) override { return ArcCache::getWithHash(key, hashOf(key), value); }
+
+    bool getWithHash(const Key& key, uint64_t hash, Value& value) override
+    {
+        MeltiCache::CacheStats::Timer timer(stats_);
+        bool needDrain = false;
+        bool stale = false;
+        uint64_t writtenAt = 0;
         {
-            lfu->put(key, value);
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            uint64_t now = clock();
+            Slot slot;
+            // an expired entry misses and is left for the wheel to reclaim
+            if (lru->find(key, hash, slot) && !(expiring_ && lru->expired(slot, now)))
+            {
+                value = lru->valueOf(slot);
+                needDrain = !readBuffer_.record(encodeAccess(kLruList, slot, lru->stampOf(slot)));
+                writtenAt = lru->writtenAtOf(slot);
+            }
+            else if (lfu->find(key, hash, slot) && !(expiring_ && lfu->expired(slot, now)))
+            {
+                value = lfu->valueOf(slot);
+                needDrain = !readBuffer_.record(encodeAccess(kLfuList, slot, lfu->stampOf(slot)));
+                writtenAt = lfu->writtenAtOf(slot);
+            }
+            else
+            {
+                stats_.record(MeltiCache::CacheStats::Counter::Misses);
+                return false;
+            }
+            stale = refreshDue(writtenAt, now);
         }
-        else
+        stats_.record(MeltiCache::CacheStats::Counter::Hits);
+        if (stale) scheduleRefresh(key, hash, writtenAt);
+        if (needDrain)
         {
-            lru->put(key, value);
+            std::unique_lock<std::shared_mutex> lock(mutex_, std::try_to_lock);
+            if (lock.owns_lock())
+            {
+                drainReadBuffer();
+            }
         }
+        return true;
+    }
+    Value get(const Key& key) override
+    {
+        Value value{};
+        get(key, value);
+        return value;
     }
 
-    bool get(Key key, Value& value) override
+    // weight held by the LRU and LFU parts together
+    size_t weightedSize() override
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        bool shouldTransform = false;
-        if (lru->get(key, value, shouldTransform))
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return lru->weightedSize() + lfu->weightedSize();
+    }
+
+    // Zero-copy hit: the handle points into the node and pins it, the access is buffered like get().
+    MeltiCache::ValueHandle<Value> getHandle(const Key& key) override
+    {
+        return ArcCache::getHandleWithHash(key, hashOf(key));
+    }
+
+    MeltiCache::ValueHandle<Value> getHandleWithHash(const Key& key, uint64_t hash) override
+    {
+        MeltiCache::ValueHandle<Value> handle;
+        bool needDrain = false;
+        bool stale = false;
+        uint64_t writtenAt = 0;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            uint64_t now = clock();
+            Slot slot;
+            if (lru->find(key, hash, slot) && !(expiring_ && lru->expired(slot, now)))
+            {
+                handle = lru->pin(slot);
+                needDrain = !readBuffer_.record(encodeAccess(kLruList, slot, lru->stampOf(slot)));
+                writtenAt = lru->writtenAtOf(slot);
+            }
+            else if (lfu->find(key, hash, slot) && !(expiring_ && lfu->expired(slot, now)))
+            {
+                handle = lfu->pin(slot);
+                needDrain = !readBuffer_.record(encodeAccess(kLfuList, slot, lfu->stampOf(slot)));
+                writtenAt = lfu->writtenAtOf(slot);
+            }
+            else
+            {
+                stats_.record(MeltiCache::CacheStats::Counter::Misses);
+                return handle;
+            }
+            stale = refreshDue(writtenAt, now);
+        }
+        stats_.record(MeltiCache::CacheStats::Counter::Hits);
+        if (stale) scheduleRefresh(key, hash, writtenAt);
+        if (needDrain)
         {
-            if (shouldTransform)
+            std::unique_lock<std::shared_mutex> lock(mutex_, std::try_to_lock);
+            if (lock.owns_lock())
             {
-                lfu->put(key, value);
-                lru->remove(key);
+                drainReadBuffer();
             }
+        }
+        return handle;
+    }
+
+    // One shared lock for the whole batch, the hashes come in computed before it: look every key up first and
+    // prefetch the nodes, then copy the values out and record the accesses.
+    size_t getManyWithHash(const std::vector<Key>& keys, const std::vector<uint64_t>& hashes,
+                           MeltiCache::BatchRange range, std::vector<Value>& values,
+                           std::vector<bool>& found) override
+    {
+        std::vector<uint64_t> hits(range.size(), MeltiCache::ReadBuffer::kEmpty);  // list flag | slot
+        size_t hitCount = 0;
+        bool needDrain = false;
+        std::vector<std::pair<size_t, uint64_t>> stale;  // index and write time of hits due for a refresh
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            uint64_t now = clock();
+            for (size_t i = range.begin; i < range.end; ++i)
+            {
+                size_t at = range[i];
+                Slot slot;
+                if (lru->find(keys[at], hashes[at], slot))
+                {
+                    if (expiring_ && lru->expired(slot, now)) continue;
+                    lru->prefetch(slot);
+                    hits[i - range.begin] = kLruList | slot;
+                }
+                else if (lfu->find(keys[at], hashes[at], slot))
+                {
+                    if (expiring_ && lfu->expired(slot, now)) continue;
+                    lfu->prefetch(slot);
+                    hits[i - range.begin] = kLfuList | slot;
+                }
+            }
+            for (size_t i = range.begin; i < range.end; ++i)
+            {
+                uint64_t hit = hits[i - range.begin];
+                if (hit == MeltiCache::ReadBuffer::kEmpty) continue;
+                size_t at = range[i];
+                Slot slot = static_cast<Slot>(hit & (kLfuList - 1));
+                uint64_t entry;
+                uint64_t writtenAt;
+                if (hit & kLfuList)
+                {
+                    values[at] = lfu->valueOf(slot);
+                    entry = encodeAccess(kLfuList, slot, lfu->stampOf(slot));
+                    writtenAt = lfu->writtenAtOf(slot);
+                }
+                else
+                {
+                    values[at] = lru->valueOf(slot);
+                    entry = encodeAccess(kLruList, slot, lru->stampOf(slot));
+                    writtenAt = lru->writtenAtOf(slot);
+                }
+                needDrain |= !readBuffer_.record(entry);
+                if (refreshDue(writtenAt, now)) stale.emplace_back(at, writtenAt);
+                found[at] = true;
+                ++hitCount;
+            }
+        }
+        stats_.record(MeltiCache::CacheStats::Counter::Hits, hitCount);
+        stats_.record(MeltiCache::CacheStats::Counter::Misses, range.size() - hitCount);
+        for (const auto& entry : stale)
+        {
+            scheduleRefresh(keys[entry.first], hashes[entry.first], entry.second);
+        }
+        if (needDrain)
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_, std::try_to_lock);
+            if (lock.owns_lock())
+            {
+                drainReadBuffer();
+            }
+        }
+        return hitCount;
+    }
+
+    void putManyWithHash(const std::vector<Key>& keys, const std::vector<uint64_t>& hashes,
+                         const std::vector<Value>& values, MeltiCache::BatchRange range) override
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        drainReadBuffer();
+        uint64_t now = clock();
+        for (size_t i = range.begin; i < range.end; ++i)
+        {
+            size_t at = range[i];
+            putEntry(keys[at], values[at], hashes[at], 0, now);
+        }
+    }
+
+    // Writes the entries with their LRU order and LFU frequencies, the LRU/LFU split and both ghost lists to
+    // path, replacing it atomically; returns false on an I/O error. Copy-on-snapshot: the state is copied
+    // under the shared lock and encoded after it is released, so reads are never blocked and writes only
+    // while the copy is made. Ghosts are fingerprints of the (unseeded) key hash, so they stay valid across
+    // restarts.
+    bool snapshot(const std::string& path)
+    {
+        MeltiCache::SnapshotWriter writer(path);
+        MeltiCache::writeSnapshotHeader(writer, 1);
+        writeSnapshot(writer);
+        return writer.commit();
+    }
+
+    // Streams a snapshot into this (still empty) cache straight from the mapped file. The split and ghost
+    // lists are taken over only if the snapshot was written with the same capacity, and entries that do not
+    // fit are skipped. Remaining times to live carry over, write times do not, so with refresh-ahead every
+    // restored entry is reloaded on its first hit. Returns false if the file is missing, of another format or
+    // cut short; the entries read up to the damage stay.
+    bool load(const std::string& path)
+    {
+        MeltiCache::SnapshotReader reader(path);
+        return MeltiCache::readSnapshotHeader(reader, 1) && readSnapshot(reader);
+    }
+
+    // One section of a snapshot file: snapshot() writes one, ShardedCache one per shard.
+    void writeSnapshot(MeltiCache::SnapshotWriter& writer)
+    {
+        SnapshotCopy copy;
+        {
+            // replay the buffered reads first, so the copied order includes them
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            drainReadBuffer();
+        }
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            uint64_t now = expiring_ ? MeltiCache::TimerWheel::now() : 0;
+            copy.capacity = capacity_;
+            copy.lruCapacity = lru->capacity();
+            copy.lfuCapacity = lfu->capacity();
+            copyEntries(*lru, now, copy.lruEntries);
+            copyEntries(*lfu, now, copy.lfuEntries);
+            lru->forEachGhost([&](uint64_t hash, size_t weight) { copy.lruGhosts.emplace_back(hash, weight); });
+            lfu->forEachGhost([&](uint64_t hash, size_t weight) { copy.lfuGhosts.emplace_back(hash, weight); });
+        }
+        writer.writeValue(copy.capacity);
+        writer.writeValue(copy.lruCapacity);
+        writer.writeValue(copy.lfuCapacity);
+        for (const auto* entries : {&copy.lruEntries, &copy.lfuEntries})
+        {
+            writer.writeValue(static_cast<uint64_t>(entries->size()));
+            for (const SnapshotEntry& entry : *entries)
+            {
+                MeltiCache::SnapshotCodec<Key>::write(writer, entry.key);
+                MeltiCache::SnapshotCodec<Value>::write(writer, entry.value);
+                writer.writeValue(entry.accessCount);
+                writer.writeValue(entry.ttl);
+            }
+        }
+        for (const auto* ghosts : {&copy.lruGhosts, &copy.lfuGhosts})
+        {
+            writer.writeValue(static_cast<uint64_t>(ghosts->size()));
+            for (const auto& ghost : *ghosts)
+            {
+                writer.writeValue(ghost.first);
+                writer.writeValue(ghost.second);
+            }
+        }
+    }
+
+    bool readSnapshot(MeltiCache::SnapshotReader& reader)
+    {
+        uint64_t capacity = 0;
+        uint64_t lruCapacity = 0;
+        uint64_t lfuCapacity = 0;
+        if (!reader.readValue(capacity) || !reader.readValue(lruCapacity) || !reader.readValue(lfuCapacity))
+        {
+            return false;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        bool samePartition = capacity == capacity_;
+        if (samePartition)
+        {
+            lru->restoreCapacity(static_cast<size_t>(lruCapacity));
+            lfu->restoreCapacity(static_cast<size_t>(lfuCapacity));
+        }
+        uint64_t now = 0;
+        Slot previous = MeltiCache::kNullSlot;
+        for (int part = 0; part < 2; ++part)
+        {
+            uint64_t count = 0;
+            if (!reader.readValue(count)) return false;
+            Key key{};
+            Value value{};
+            for (uint64_t i = 0; i < count; ++i)
+            {
+                uint64_t accessCount = 0;
+                uint64_t ttl = 0;
+                if (!MeltiCache::SnapshotCodec<Key>::read(reader, key) ||
+                    !MeltiCache::SnapshotCodec<Value>::read(reader, value) || !reader.readValue(accessCount) ||
+                    !reader.readValue(ttl))
+                {
+                    return false;
+                }
+                size_t weight = MeltiCache::weightOf(weigher_, key, value);
+                uint64_t hash = hashOf(key);
+                Slot slot;
+                if (part == 0)
+                {
+                    slot = lru->restore(std::move(key), std::move(value), weight, hash, accessCount);
+                }
+                else
+                {
+                    slot = lfu->restore(std::move(key), std::move(value), weight, hash, accessCount, previous);
+                    if (slot != MeltiCache::kNullSlot) previous = slot;
+                }
+                if (slot == MeltiCache::kNullSlot || ttl == 0) continue;
+                if (now == 0) now = MeltiCache::TimerWheel::now();
+                expiring_ = true;
+                if (part == 0)
+                    lru->setDeadline(slot, now + ttl);
+                else
+                    lfu->setDeadline(slot, now + ttl);
+            }
+        }
+        for (int part = 0; part < 2; ++part)
+        {
+            uint64_t count = 0;
+            if (!reader.readValue(count)) return false;
+            for (uint64_t i = 0; i < count; ++i)
+            {
+                uint64_t hash = 0;
+                uint64_t weight = 0;
+                if (!reader.readValue(hash) || !reader.readValue(weight)) return false;
+                if (!samePartition) continue;
+                if (part == 0)
+                    lru->restoreGhost(hash, static_cast<size_t>(weight));
+                else
+                    lfu->restoreGhost(hash, static_cast<size_t>(weight));
+            }
+        }
+        return true;
+    }
+
+#if defined(__cpp_impl_coroutine)
+    // co_await cache.co_getOrLoad(key, loader, executor) for coroutine servers: a hit completes without
+    // suspending; a miss suspends the coroutine and runs getOrLoad() on the executor, so concurrent misses
+    // still share one load and no server thread blocks on the backend. The coroutine resumes on an executor
+    // thread with the value, or with the loader's exception. Without an executor the miss loads on the
+    // calling thread and the coroutine goes on without suspending.
+    template <typename Loader>
+    class LoadAwaiter
+    {
+      public:
+        LoadAwaiter(ArcCache& cache, const Key& key, Loader loader, MeltiCache::Executor* executor)
+            : cache_(cache), key_(key), loader_(std::move(loader)), executor_(executor), value_()
+        {
+        }
+
+        bool await_ready() { return cache_.get(key_, value_); }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            if (!executor_)
+            {
+                load();
+                return false;
+            }
+            executor_->submit(
+                [this, handle]()
+                {
+                    load();
+                    handle.resume();
+                });
             return true;
         }
-        return lfu->get(key, value);
+
+        Value await_resume()
+        {
+            if (error_) std::rethrow_exception(error_);
+            return std::move(value_);
+        }
+
+      private:
+        void load()
+        {
+            try
+            {
+                value_ = cache_.getOrLoad(key_, loader_);
+            }
+            catch (...)
+            {
+                error_ = std::current_exception();
+            }
+        }
+
+        ArcCache& cache_;
+        Key key_;
+        Loader loader_;
+        MeltiCache::Executor* executor_;
+        Value value_;
+        std::exception_ptr error_;
+    };
+
+    template <typename Loader>
+    LoadAwaiter<std::decay_t<Loader>> co_getOrLoad(const Key& key, Loader&& loader, MeltiCache::Executor& executor)
+    {
+        return {*this, key, std::forward<Loader>(loader), &executor};
     }
-    Value get(Key key) override
+
+    // co_getOrLoad() through the loader and executor given to setLoader(). Before setLoader() a hit still
+    // completes and a miss resumes with std::bad_function_call from the missing loader.
+    LoadAwaiter<LoadFunction> co_get(const Key& key) { return {*this, key, loader_, executor_}; }
+#endif
+
+    // Counters, the current LRU/LFU split and, when sampling is on, operation latencies. The counters are read
+    // without locking, the split under the shared lock.
+    MeltiCache::CacheStatsSnapshot stats()
     {
-        Value value{};
-        get(key, value);
-        return value;
+        MeltiCache::CacheStatsSnapshot snapshot;
+        stats_.fill(snapshot);
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        snapshot.lruEvictions = lru->evictions();
+        snapshot.lfuEvictions = lfu->evictions();
+        snapshot.evictions = snapshot.lruEvictions + snapshot.lfuEvictions;
+        snapshot.lruCapacity = lru->capacity();
+        snapshot.lfuCapacity = lfu->capacity();
+        snapshot.lruWeight = lru->weightedSize();
+        snapshot.lfuWeight = lfu->weightedSize();
+        return snapshot;
     }
 
+    // times every period-th get/put of each thread into the snapshot's latency histogram, 0 turns it off
+    void setLatencySampling(uint32_t period) { stats_.setLatencySampling(period); }
+
   private:
+    using Slot = MeltiCache::SlotIndex;
+
+    // buffered access record: stamp in the high word, list flag in bit 31, pool slot below it
+    static constexpr uint64_t kLruList = 0;
+    static constexpr uint64_t kLfuList = uint64_t(1) << 31;
+
+    static uint64_t encodeAccess(uint64_t list, Slot slot, uint32_t stamp)
+    {
+        return (static_cast<uint64_t>(stamp) << 32) | list | slot;
+    }
+
+    struct SnapshotEntry
+    {
+        Key key;
+        Value value;
+        uint64_t accessCount;  // LRU access count or LFU frequency
+        uint64_t ttl;          // remaining time to live, ns, 0 for none
+    };
+
+    // what writeSnapshot() copies under the lock; entries in forEachEntry() order, ghosts oldest first
+    struct SnapshotCopy
+    {
+        uint64_t capacity = 0;
+        uint64_t lruCapacity = 0;
+        uint64_t lfuCapacity = 0;
+        std::vector<SnapshotEntry> lruEntries;
+        std::vector<SnapshotEntry> lfuEntries;
+        std::vector<std::pair<uint64_t, uint64_t>> lruGhosts;
+        std::vector<std::pair<uint64_t, uint64_t>> lfuGhosts;
+    };
+
+    // caller holds the lock; expired entries are left out
+    template <typename Part>
+    static void copyEntries(const Part& part, uint64_t now, std::vector<SnapshotEntry>& entries)
+    {
+        part.forEachEntry(
+            [&](Slot slot)
+            {
+                uint64_t deadline = part.deadlineOf(slot);
+                if (deadline != 0 && deadline <= now) return;
+                entries.push_back({part.keyOf(slot), part.valueOf(slot), part.accessCountOf(slot),
+                                   deadline ? deadline - now : 0});
+            });
+    }
+
+    static uint64_t toNanos(Duration ttl) { return ttl.count() > 0 ? static_cast<uint64_t>(ttl.count()) : 0; }
+
+    static uint64_t hashOf(const Key& key) { return MeltiCache::Hasher<Key>{}(key); }
+
     size_t capacity_;
     size_t transformNeed_;
+    Weigher weigher_;
     std::unique_ptr<ArcLru<Key, Value>> lru;
     std::unique_ptr<ArcLfu<Key, Value>> lfu;
-    std::mutex mutex_;
+    std::shared_mutex mutex_;
+    MeltiCache::ReadBuffer readBuffer_;
+    MeltiCache::CacheStats stats_;
+    uint64_t expireAfterWrite_ = 0;   // default time to live after a write, ns, 0 for none
+    uint64_t expireAfterAccess_ = 0;  // default idle time, ns
+    bool expiring_ = false;           // set once any expiry is in use, written under the exclusive lock
+    uint64_t refreshAfter_ = 0;       // refresh-ahead age, ns, 0 for none
+    LoadFunction loader_;
+    MeltiCache::Executor* executor_ = nullptr;
+    std::mutex refreshMutex_;  // guards refreshing_, never held together with mutex_
+    std::condition_variable refreshDone_;
+    std::unordered_set<Key, MeltiCache::Hasher<Key>> refreshing_;  // keys with a reload scheduled or running
 
   private:
-    bool checkGhostCaches(Key key)
+    // caller holds the exclusive lock; reclaims expired entries, writes, then arms the entry's timer
+    // (ttl 0 picks the configured default). Batch callers pass the now they read once for the batch.
+    template <typename K, typename V>
+    void putEntry(K&& key, V&& value, uint64_t hash, uint64_t ttl, uint64_t now = 0)
+    {
+        stats_.record(MeltiCache::CacheStats::Counter::Puts);
+        if (!expiring_ && !refreshAfter_)
+        {
+            putImpl(std::forward<K>(key), std::forward<V>(value), hash);
+            return;
+        }
+        if (now == 0) now = MeltiCache::TimerWheel::now();
+        if (expiring_) expireEntries(now);
+        uint64_t entry = putImpl(std::forward<K>(key), std::forward<V>(value), hash);
+        if (entry == MeltiCache::ReadBuffer::kEmpty) return;
+        Slot slot = static_cast<Slot>(entry & (kLfuList - 1));
+        if (refreshAfter_)
+        {
+            if (entry & kLfuList)
+                lfu->setWrittenAt(slot, now);
+            else
+                lru->setWrittenAt(slot, now);
+        }
+        if (!expiring_) return;
+        if (ttl == 0) ttl = expireAfterWrite_ ? expireAfterWrite_ : expireAfterAccess_;
+        if (entry & kLfuList)
+            lfu->setDeadline(slot, ttl ? now + ttl : 0);
+        else
+            lru->setDeadline(slot, ttl ? now + ttl : 0);
+    }
+
+    // the clock is read only when expiry or refresh-ahead is on
+    uint64_t clock() const { return expiring_ || refreshAfter_ ? MeltiCache::TimerWheel::now() : 0; }
+
+    // entries written before refresh-ahead was turned on have no write time and count as stale
+    bool refreshDue(uint64_t writtenAt, uint64_t now) const
+    {
+        return refreshAfter_ && now - writtenAt >= refreshAfter_;
+    }
+
+    // called without mutex_ after a stale hit; writtenAt identifies the version that was read
+    void scheduleRefresh(const Key& key, uint64_t hash, uint64_t writtenAt)
+    {
+        if (!executor_) return;
+        {
+            std::lock_guard<std::mutex> lock(refreshMutex_);
+            if (!refreshing_.insert(key).second) return;
+        }
+        executor_->submit([this, key, hash, writtenAt]() { refresh(key, hash, writtenAt); });
+    }
+
+    // runs on the executor: the loader runs without any lock, the write is skipped if the entry changed
+    void refresh(const Key& key, uint64_t hash, uint64_t writtenAt)
+    {
+        try
+        {
+            Value value = loader_(key);
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            drainReadBuffer();
+            uint64_t now = MeltiCache::TimerWheel::now();
+            Slot slot;
+            bool current = false;
+            if (lru->find(key, hash, slot))
+                current = lru->writtenAtOf(slot) == writtenAt && !(expiring_ && lru->expired(slot, now));
+            else if (lfu->find(key, hash, slot))
+                current = lfu->writtenAtOf(slot) == writtenAt && !(expiring_ && lfu->expired(slot, now));
+            if (current) putEntry(key, std::move(value), hash, 0, now);
+        }
+        catch (...)
+        {
+            // the old value stays, the next stale hit schedules another reload
+        }
+        std::lock_guard<std::mutex> lock(refreshMutex_);
+        refreshing_.erase(key);
+        refreshDone_.notify_all();
+    }
+
+    void expireEntries(uint64_t now)
+    {
+        size_t expired = lru->expire(now) + lfu->expire(now);
+        if (expired) stats_.record(MeltiCache::CacheStats::Counter::Expirations, expired);
+    }
+
+    // caller holds the exclusive lock; returns list flag | slot of the written entry, or kEmpty
+    template <typename K, typename V>
+    uint64_t putImpl(K&& key, V&& value, uint64_t hash)
+    {
+        // if key in the lru ghost, lfu decrease capacity, lru increase capacity
+        // if key not in the lru ghost
+        size_t weight = MeltiCache::weightOf(weigher_, static_cast<const Key&>(key), static_cast<const Value&>(value));
+        Slot slot;
+        bool inLfu = lfu->countain(key, hash);
+        // only a key that is not cached can be a ghost hit; one kept in LRU after a refused ghost hit stays there
+        bool isGhost = !inLfu && !lru->find(key, hash, slot) && checkGhostCaches(hash, weight);
+        // a ghost hit goes to the LFU part unless adaptation has shrunk its budget below the entry
+        if (inLfu || (isGhost && lfu->fits(weight)))
+        {
+            slot = lfu->put(std::forward<K>(key), std::forward<V>(value), weight, hash);
+            return slot == MeltiCache::kNullSlot ? MeltiCache::ReadBuffer::kEmpty : kLfuList | slot;
+        }
+        slot = lru->put(std::forward<K>(key), std::forward<V>(value), weight, hash);
+        return slot == MeltiCache::kNullSlot ? MeltiCache::ReadBuffer::kEmpty : kLruList | slot;
+    }
+
+    // replays buffered reads, caller holds the exclusive lock
+    void drainReadBuffer()
+    {
+        // idle expiry pushes deadlines from the time of this drain, the clock is read at most once per drain
+        bool extend = expiring_ && expireAfterAccess_ && !expireAfterWrite_;
+        uint64_t now = 0;
+        readBuffer_.drain(
+            [this, extend, &now](uint64_t entry)
+            {
+                Slot slot = static_cast<Slot>(entry & (kLfuList - 1));
+                uint32_t stamp = static_cast<uint32_t>(entry >> 32);
+                if (entry & kLfuList)
+                {
+                    if (lfu->recordAccess(slot, stamp) && extend) extendDeadline(*lfu, slot, now);
+                    return;
+                }
+                bool shouldTransform = false;
+                if (!lru->recordAccess(slot, stamp, shouldTransform)) return;
+                if (extend) extendDeadline(*lru, slot, now);
+                if (shouldTransform)
+                {
+                    // the entry keeps its deadline, write time and cached hash when it moves to the LFU part
+                    uint64_t deadline = lru->deadlineOf(slot);
+                    Slot moved = lfu->put(lru->keyOf(slot), lru->valueOf(slot), lru->weightOf(slot), lru->hashOf(slot));
+                    if (moved == MeltiCache::kNullSlot) return;  // the LFU part has no room, stay in LRU
+                    lfu->setDeadline(moved, deadline);
+                    lfu->setWrittenAt(moved, lru->writtenAtOf(slot));
+                    lru->removeAt(slot);
+                }
+            });
+    }
+
+    // expired entries are not revived by a late replay of a read
+    template <typename Part>
+    void extendDeadline(Part& part, Slot slot, uint64_t& now)
+    {
+        if (part.deadlineOf(slot) == 0) return;
+        if (now == 0) now = MeltiCache::TimerWheel::now();
+        if (!part.expired(slot, now)) part.setDeadline(slot, now + expireAfterAccess_);
+    }
+
+    // the split moves by the weight of the incoming entry, i.e. by one entry without a weigher
+    bool checkGhostCaches(uint64_t hash, size_t weight)
     {
         // if lru ghost countain key,lfu decrease capacity, lru increase capacity
-        if (lru->ghostContain(key))
+        if (lru->ghostContain(hash))
         {
-            lfu->decreaseCapacity();
-            lru->increaseCapacity();
+            stats_.record(MeltiCache::CacheStats::Counter::LruGhostHits);
+            lru->increaseCapacity(lfu->decreaseCapacity(weight));
             return true;
         }
-        if (lfu->ghostCountain(key))
+        if (lfu->ghostCountain(hash))
         {
-            lru->decreaseCapacity();
-            lfu->increaseCapacity();
+            stats_.record(MeltiCache::CacheStats::Counter::LfuGhostHits);
+            lfu->increaseCapacity(lru->decreaseCapacity(weight));
             return true;
         }
         return false;
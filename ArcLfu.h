@@ -1,171 +1,441 @@
 #pragma once
+#include <algorithm>
 #include <cstddef>
-#include <list>
+#include <cstdint>
 #include <memory>
-#include <mutex>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "ArcNode.h"
+#include "FlatIndex.h"
+#include "GhostList.h"
+#include "NodePool.h"
+#include "TimerWheel.h"
+#include "ValueHandle.h"
 template <typename Key, typename Value>
 class ArcLfu
 {
   public:
     using NodeType = ArcNode<Key, Value>;
-    using NodePtr = std::shared_ptr<NodeType>;
-    using NodeMap = std::unordered_map<Key, NodePtr>;
-    using FreqMap = std::unordered_map<size_t, std::list<NodePtr>>;  // Key is the frequncy of Node, Value is the Node's
-                                                                     // frequncy which can match the Key
+    using NodePool = MeltiCache::NodePool<NodeType>;
+    using Slot = MeltiCache::SlotIndex;
+    using NodeMap = MeltiCache::FlatIndex<Key>;
+
+    // One bucket per distinct frequency. Buckets form a list ordered by frequency so the first one is
+    // always the minimal frequency; nodes of a bucket are chained through their own pre_/next_ slots
+    // and remember their bucket, so a hit unlinks and relinks in O(1). Empty buckets go to a free list.
+    struct FreqBucket
+    {
+        size_t freq;
+        Slot head;  // oldest node, evicted first
+        Slot tail;
+        uint32_t prev;
+        uint32_t next;
+    };
 
   public:
-    ArcLfu(size_t capacity) : mainCapacity_(capacity), ghostCapacity_(capacity), minFreq_(0) { initializeLists(); }
+    // weighted: capacity is a weight budget, so the entry count is unknown and the pool grows on demand
+    ArcLfu(size_t capacity, bool weighted = false)
+        : mainCapacity_(capacity), weightedSize_(0), evictions_(0), minFreq_(0), pool_(weighted ? 0 : capacity),
+          ghost_(capacity, weighted), firstBucket_(kNoBucket)
+    {
+        if (!weighted)
+        {
+            buckets_.reserve(capacity + 1);
+            mainCache_.reserve(capacity);
+        }
+    }
+
+    // K/V are forwarding references: rvalues are moved all the way into the pooled node
+    // weight is the entry's weight as computed by ArcCache's weigher; returns the entry's slot, or kNullSlot
+    // when it was not cached
+    template <typename K, typename V>
+    Slot put(K&& key, V&& value, size_t weight = 1)
+    {
+        uint64_t hash = mainCache_.hash(key);
+        return put(std::forward<K>(key), std::forward<V>(value), weight, hash);
+    }
 
-    bool put(Key key, Value value)
+    // hash is MeltiCache::Hasher of the key, computed once by ArcCache
+    template <typename K, typename V>
+    Slot put(K&& key, V&& value, size_t weight, uint64_t hash)
     {
-        if (mainCapacity_ == 0) return false;
+        if (mainCapacity_ == 0) return MeltiCache::kNullSlot;
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = mainCache_.find(key);
-        if (it != mainCache_.end())
+        Slot slot = findSlot(key, hash);
+        if (slot != MeltiCache::kNullSlot)
         {
-            return updateExistingNode(it->second, value);
+            return updateExistingNode(slot, std::forward<V>(value), weight);
         }
-        return addNewNode(key, value);
+        return addNewNode(std::forward<K>(key), std::forward<V>(value), weight, hash);
     }
 
-    bool get(Key key, Value& value)
+    bool get(const Key& key, Value& value)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = mainCache_.find(key);
-        if (it != mainCache_.end())
+        Slot slot = findSlot(key, mainCache_.hash(key));
+        if (slot != MeltiCache::kNullSlot)
         {
-            updateNodeFrequency(it->second);
-            value = it->second->getValue();
+            updateNodeFrequency(slot);
+            value = pool_[slot].value_;
             return true;
         }
         return false;
     }
     
-    void decreaseCapacity()
+    // Lookup without bumping the frequency, safe for concurrent readers under ArcCache's shared lock.
+    bool find(const Key& key, uint64_t hash, Slot& slot) const
+    {
+        slot = findSlot(key, hash);
+        return slot != MeltiCache::kNullSlot;
+    }
+    const Value& valueOf(Slot slot) const { return pool_[slot].value_; }
+    uint32_t stampOf(Slot slot) const { return pool_[slot].stamp_; }
+    MeltiCache::ValueHandle<Value> pin(Slot slot) const { return {&pool_[slot].value_, &pool_.pins(slot)}; }
+    void prefetch(Slot slot) const { pool_.prefetch(slot); }
+
+    // Expiry of main entries, same contract as ArcLru.
+    void setDeadline(Slot slot, uint64_t deadline) { wheel_.schedule(slot, deadline); }
+    uint64_t deadlineOf(Slot slot) const { return wheel_.deadlineOf(slot); }
+    bool expired(Slot slot, uint64_t now) const { return wheel_.expired(slot, now); }
+    // time of the entry's last write, kept by ArcCache for refresh-ahead
+    void setWrittenAt(Slot slot, uint64_t now) { pool_[slot].writtenAt_ = now; }
+    uint64_t writtenAtOf(Slot slot) const { return pool_[slot].writtenAt_; }
+    size_t expire(uint64_t now)
+    {
+        size_t expired = 0;
+        wheel_.advance(now, [this, &expired](Slot slot) {
+            removeEntry(slot);
+            ++expired;
+        });
+        return expired;
+    }
+
+    // Replays a buffered read, ignored (returns false) if the slot has been evicted or reused since.
+    bool recordAccess(Slot slot, uint32_t stamp)
+    {
+        if (pool_[slot].stamp_ != stamp) return false;
+        updateNodeFrequency(slot);
+        return true;
+    }
+
+    // ARC adaptation, delta is in weight units. Gives up at most the whole budget and returns how much it gave,
+    // which is all the other part may take, so the two budgets always add up to the same total.
+    size_t decreaseCapacity(size_t delta)
     {
-        if(mainCache_.size()==mainCapacity_)
+        size_t given = std::min(delta, mainCapacity_);
+        mainCapacity_ -= given;
+        while (weightedSize_ > mainCapacity_)
         {
             evictLeastFrequent();
         }
-        --mainCapacity_;
+        return given;
     }
-    void increaseCapacity()
+    void increaseCapacity(size_t delta)
     {
-        ++mainCapacity_;
+        mainCapacity_ += delta;
     }
-    bool ghostCountain(Key key)
+    // whether an entry of this weight can be stored at the current budget
+    bool fits(size_t weight) const { return mainCapacity_ != 0 && weight <= mainCapacity_; }
+
+    // Snapshot support, same contract as ArcLru. forEachEntry visits by ascending frequency, oldest first
+    // within a frequency, which is the order restore() expects.
+    template <typename Fn>
+    void forEachEntry(Fn&& fn) const
     {
-        auto it = ghostCache_.find(key);
-        return it != ghostCache_.end();
+        for (uint32_t bucket = firstBucket_; bucket != kNoBucket; bucket = buckets_[bucket].next)
+        {
+            for (Slot slot = buckets_[bucket].head; slot != MeltiCache::kNullSlot; slot = pool_[slot].next_)
+            {
+                fn(slot);
+            }
+        }
     }
-    bool countain(Key key)
+    const Key& keyOf(Slot slot) const { return pool_[slot].key_; }
+    size_t accessCountOf(Slot slot) const { return pool_[slot].accessCount_; }
+    template <typename Fn>
+    void forEachGhost(Fn&& fn) const
     {
-       return mainCache_.find(key) != mainCache_.end();
+        ghost_.forEach(std::forward<Fn>(fn));
+    }
+    void restoreCapacity(size_t capacity) { mainCapacity_ = capacity; }
+    // Appends to the highest-frequency bucket, or a new one after it. previous is the slot the last restore
+    // returned (kNullSlot for the first entry into the empty part), so no bucket search is needed; never
+    // evicts, returns kNullSlot when the entry does not fit.
+    template <typename K, typename V>
+    Slot restore(K&& key, V&& value, size_t weight, uint64_t hash, size_t freq, Slot previous)
+    {
+        if (weightedSize_ + weight > mainCapacity_ || findSlot(key, hash) != MeltiCache::kNullSlot)
+        {
+            return MeltiCache::kNullSlot;
+        }
+        uint32_t last = previous == MeltiCache::kNullSlot ? kNoBucket : pool_[previous].bucket_;
+        if (last != kNoBucket) freq = std::max(freq, buckets_[last].freq);  // keep the buckets sorted
+        Slot newNode = pool_.allocate();
+        NodeType &node = pool_[newNode];
+        mainCache_.insert(hash, newNode);
+        node.key_ = std::forward<K>(key);
+        node.hash_ = hash;
+        node.writtenAt_ = 0;
+        node.value_ = std::forward<V>(value);
+        node.accessCount_ = freq;
+        node.weight_ = weight;
+        weightedSize_ += weight;
+        uint32_t bucket = last;
+        if (bucket == kNoBucket || buckets_[bucket].freq != freq)
+        {
+            bucket = insertBucketAfter(last, freq);
+        }
+        appendToBucket(bucket, newNode);
+        minFreq_ = buckets_[firstBucket_].freq;
+        return newNode;
+    }
+    void restoreGhost(uint64_t hash, size_t weight) { ghost_.pushHash(hash, weight); }
+    size_t weightedSize() const { return weightedSize_; }
+    size_t capacity() const { return mainCapacity_; }
+    size_t evictions() const { return evictions_; }
+    bool ghostCountain(uint64_t hash) const { return ghost_.containsHash(hash); }
+    bool countain(const Key& key, uint64_t hash) const
+    {
+       return findSlot(key, hash) != MeltiCache::kNullSlot;
     }
 
   private:
-    size_t mainCapacity_;       // main cache total capacity
-    size_t ghostCapacity_;  // ghost cache capacity
+    size_t mainCapacity_;   // main cache capacity, in weight units (entries without a weigher)
+    size_t weightedSize_;   // total weight of the main cache
+    size_t evictions_;      // capacity evictions to the ghost list, for ArcCache's stats
     size_t minFreq_;        // minimal of the node frequency
+    NodePool pool_;         // main nodes only, evicted slots are recycled
     NodeMap mainCache_;
-    NodeMap ghostCache_;
-    FreqMap freqMap_;
+    MeltiCache::GhostList<Key> ghost_;  // fingerprints of recently evicted keys, same capacity as the main cache
+    std::vector<FreqBucket> buckets_;
+    std::vector<uint32_t> freeBuckets_;
+    uint32_t firstBucket_;  // bucket of minFreq_
+    MeltiCache::TimerWheel wheel_;  // expiry of main entries, armed by ArcCache
 
-    NodePtr ghostHead_;
-    NodePtr ghostTail_;
-    std::mutex mutex_;
+    static constexpr uint32_t kNoBucket = UINT32_MAX;
 
   private:
-    void initializeLists()
+    // slot of the key in the main list, kNullSlot if absent; keys are compared against the pooled nodes
+    Slot findSlot(const Key& key, uint64_t hash) const
     {
-        ghostHead_ = std::make_shared<NodeType>();
-        ghostTail_ = std::make_shared<NodeType>();
-        ghostHead_->next_ = ghostTail_;
-        ghostTail_->pre_ = ghostHead_;
+        return mainCache_.find(hash, [&](Slot slot) { return pool_[slot].key_ == key; });
     }
 
-    bool updateExistingNode(NodePtr node, Value value)
+    template <typename V>
+    Slot updateExistingNode(Slot node, V&& value, size_t weight)
     {
-        node->setValue(value);
+        if (weight > mainCapacity_)
+        {
+            // the new value alone does not fit, drop the entry
+            removeEntry(node);
+            return MeltiCache::kNullSlot;
+        }
+        if (pool_.isPinned(node))
+        {
+            node = replacePinnedNode(node);
+        }
+        pool_[node].setValue(std::forward<V>(value));
+        weightedSize_ = weightedSize_ - pool_[node].weight_ + weight;
+        pool_[node].weight_ = weight;
         updateNodeFrequency(node);
-        return true;
+        // a heavier value may overflow the budget, evict others but never the node just written
+        while (weightedSize_ > mainCapacity_)
+        {
+            evictLeastFrequent(node);
+        }
+        return node;
     }
 
-    bool addNewNode(Key key, Value value)
+    // A handle still reads the old value: a fresh node takes its place in the same bucket.
+    Slot replacePinnedNode(Slot old)
     {
-        if (mainCache_.size() >= mainCapacity_)
+        Slot node = pool_.allocate();
+        NodeType &cur = pool_[node];
+        NodeType &prev = pool_[old];
+        FreqBucket &b = buckets_[prev.bucket_];
+        cur.key_ = prev.key_;
+        cur.accessCount_ = prev.accessCount_;
+        cur.weight_ = prev.weight_;
+        cur.hash_ = prev.hash_;
+        cur.writtenAt_ = prev.writtenAt_;
+        cur.bucket_ = prev.bucket_;
+        cur.pre_ = prev.pre_;
+        cur.next_ = prev.next_;
+        if (cur.pre_ != MeltiCache::kNullSlot)
+            pool_[cur.pre_].next_ = node;
+        else
+            b.head = node;
+        if (cur.next_ != MeltiCache::kNullSlot)
+            pool_[cur.next_].pre_ = node;
+        else
+            b.tail = node;
+        prev.pre_ = MeltiCache::kNullSlot;
+        prev.next_ = MeltiCache::kNullSlot;
+        ++prev.stamp_;
+        mainCache_.replace(cur.hash_, old, node);
+        uint64_t deadline = wheel_.deadlineOf(old);
+        wheel_.deschedule(old);
+        wheel_.schedule(node, deadline);
+        pool_.release(old);  // pinned, so its value stays for the handle
+        return node;
+    }
+
+    template <typename K, typename V>
+    Slot addNewNode(K&& key, V&& value, size_t weight, uint64_t hash)
+    {
+        if (weight > mainCapacity_) return MeltiCache::kNullSlot;
+        while (weightedSize_ + weight > mainCapacity_)
         {
             evictLeastFrequent();
         }
-        auto newNode = std::make_shared<NodeType>(key, value);
-        mainCache_[key] = newNode;
-        freqMap_[1].push_back(newNode);
+        Slot newNode = pool_.allocate();
+        NodeType &node = pool_[newNode];
+        mainCache_.insert(hash, newNode);
+        node.key_ = std::forward<K>(key);
+        node.hash_ = hash;
+        node.writtenAt_ = 0;
+        node.value_ = std::forward<V>(value);
+        node.accessCount_ = 1;
+        node.weight_ = weight;
+        weightedSize_ += weight;
+        uint32_t bucket = firstBucket_;
+        if (bucket == kNoBucket || buckets_[bucket].freq != 1)
+        {
+            bucket = insertBucketAfter(kNoBucket, 1);
+        }
+        appendToBucket(bucket, newNode);
         minFreq_ = 1;
-        return true;
+        return newNode;
     }
-    void updateNodeFrequency(NodePtr node)
+    void updateNodeFrequency(Slot node)
     {
-        auto oldFreq = node->getAccessCount();
-        node->incrementAccessCount();
-        auto newFreq = node->getAccessCount();
-        freqMap_[oldFreq].remove(node);
-        if (freqMap_[oldFreq].empty())
+        uint32_t oldBucket = pool_[node].bucket_;
+        pool_[node].incrementAccessCount();
+        auto newFreq = pool_[node].getAccessCount();
+
+        // the next bucket is either freq + 1 or a new one slotted right after the current bucket
+        uint32_t newBucket = buckets_[oldBucket].next;
+        if (newBucket == kNoBucket || buckets_[newBucket].freq != newFreq)
         {
-            freqMap_.erase(oldFreq);
-            if (minFreq_ == oldFreq)
-            {
-                minFreq_++;
-            }
+            newBucket = insertBucketAfter(oldBucket, newFreq);
         }
-        freqMap_[newFreq].push_back(node);
+        unlinkFromBucket(oldBucket, node);
+        appendToBucket(newBucket, node);
+        minFreq_ = buckets_[firstBucket_].freq;
     }
 
-    // 从 Ghost 链表中移除节点（双向链表操作）
-    void removeNode(NodePtr node)
+    uint32_t insertBucketAfter(uint32_t prev, size_t freq)
     {
-        auto preNode = node->pre_.lock();
-        if (preNode)
+        uint32_t bucket;
+        if (!freeBuckets_.empty())
         {
-            preNode->next_ = node->next_;
-            if (node->next_)
-            {
-                node->next_->pre_ = preNode;
-            }
+            bucket = freeBuckets_.back();
+            freeBuckets_.pop_back();
         }
-        node->next_ = nullptr;
+        else
+        {
+            bucket = static_cast<uint32_t>(buckets_.size());
+            buckets_.emplace_back();
+        }
+        FreqBucket &b = buckets_[bucket];
+        b.freq = freq;
+        b.head = MeltiCache::kNullSlot;
+        b.tail = MeltiCache::kNullSlot;
+        b.prev = prev;
+        b.next = prev == kNoBucket ? firstBucket_ : buckets_[prev].next;
+        if (b.next != kNoBucket) buckets_[b.next].prev = bucket;
+        if (prev == kNoBucket)
+            firstBucket_ = bucket;
+        else
+            buckets_[prev].next = bucket;
+        return bucket;
     }
 
-    void evictLeastFrequent()
+    void appendToBucket(uint32_t bucket, Slot node)
     {
-        auto it = freqMap_.find(minFreq_);
-        if (it == freqMap_.end() || it->second.empty()) return;
+        FreqBucket &b = buckets_[bucket];
+        NodeType &cur = pool_[node];
+        cur.bucket_ = bucket;
+        cur.pre_ = b.tail;
+        cur.next_ = MeltiCache::kNullSlot;
+        if (b.tail != MeltiCache::kNullSlot)
+            pool_[b.tail].next_ = node;
+        else
+            b.head = node;
+        b.tail = node;
+    }
 
-        // LFU 策略：移除 minFreq 链表头部的节点（最早进入该频率的节点）
-        NodePtr victim = it->second.front();
-        it->second.pop_front();
-        if (it->second.empty())
+    // unlink a node from its bucket, an emptied bucket is unhooked and kept for reuse
+    void unlinkFromBucket(uint32_t bucket, Slot node)
+    {
+        FreqBucket &b = buckets_[bucket];
+        NodeType &cur = pool_[node];
+        if (cur.pre_ != MeltiCache::kNullSlot)
+            pool_[cur.pre_].next_ = cur.next_;
+        else
+            b.head = cur.next_;
+        if (cur.next_ != MeltiCache::kNullSlot)
+            pool_[cur.next_].pre_ = cur.pre_;
+        else
+            b.tail = cur.pre_;
+        cur.pre_ = MeltiCache::kNullSlot;
+        cur.next_ = MeltiCache::kNullSlot;
+
+        if (b.head == MeltiCache::kNullSlot)
         {
-            freqMap_.erase(it);
+            if (b.prev != kNoBucket)
+                buckets_[b.prev].next = b.next;
+            else
+                firstBucket_ = b.next;
+            if (b.next != kNoBucket) buckets_[b.next].prev = b.prev;
+            freeBuckets_.push_back(bucket);
         }
-        mainCache_.erase(victim->getKey());
+    }
+
+    // drops a main entry without sending it to the ghost list
+    void removeEntry(Slot node)
+    {
+        unlinkFromBucket(pool_[node].bucket_, node);
+        ++pool_[node].stamp_;
+        wheel_.deschedule(node);
+        weightedSize_ -= pool_[node].weight_;
+        mainCache_.erase(pool_[node].hash_, node);
+        releaseNode(node);
+        if (firstBucket_ != kNoBucket) minFreq_ = buckets_[firstBucket_].freq;
+    }
+
+    // the value is freed now rather than when the slot is reused, unless a handle still reads it
+    void releaseNode(Slot node)
+    {
+        if (!pool_.isPinned(node)) pool_[node].clear();
+        pool_.release(node);
+    }
 
-        // 将淘汰的节点加入 Ghost 缓存 (用于 ARC 策略调整)
-        if (ghostCache_.size() >= ghostCapacity_)
+    // keep: a node that must survive (it was just written); it sits at the tail of its bucket, so it is
+    // only the head when it is alone there and the victim then comes from the next bucket
+    void evictLeastFrequent(Slot keep = MeltiCache::kNullSlot)
+    {
+        if (firstBucket_ == kNoBucket) return;
+
+        // LFU 策略：移除 minFreq 链表头部的节点（最早进入该频率的节点）
+        uint32_t bucket = firstBucket_;
+        Slot victim = buckets_[bucket].head;
+        if (victim == keep)
         {
-            // 移除 Ghost 链表中最旧的 (Tail 的前一个)
-            auto lastGhost = ghostTail_->pre_.lock();
-            removeNode(lastGhost);
-            ghostCache_.erase(lastGhost->getKey());
+            bucket = buckets_[bucket].next;
+            if (bucket == kNoBucket) return;
+            victim = buckets_[bucket].head;
         }
-        // 加入 Ghost 链表头部
-        victim->pre_ = ghostHead_;
-        victim->next_ = ghostHead_->next_;
-        ghostHead_->next_->pre_ = victim;
-        ghostHead_->next_ = victim;
-        ghostCache_[victim->getKey()] = victim;
+        unlinkFromBucket(bucket, victim);
+        ++pool_[victim].stamp_;
+        wheel_.deschedule(victim);
+        if (firstBucket_ != kNoBucket) minFreq_ = buckets_[firstBucket_].freq;
+        weightedSize_ -= pool_[victim].weight_;
+        mainCache_.erase(pool_[victim].hash_, victim);
+
+        // 只把被淘汰key的指纹记进 Ghost 列表 (用于 ARC 策略调整), value 随节点一起释放
+        ghost_.pushHash(pool_[victim].hash_, pool_[victim].weight_);
+        releaseNode(victim);
+        ++evictions_;
     }
 };
\ No newline at end of file
@@ -1,165 +1,331 @@
 #pragma once
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <unordered_map>
+#include <utility>
 
 #include "ArcNode.h"
+#include "FlatIndex.h"
+#include "GhostList.h"
 #include "LRUCache.h"
+#include "NodePool.h"
+#include "TimerWheel.h"
+#include "ValueHandle.h"
 
 template <typename Key, typename Value>
 class ArcLru
 {
   public:
     using NodeType = ArcNode<Key, Value>;
-    using NodePtr = std::shared_ptr<NodeType>;
-    using NodeMap = std::unordered_map<Key, NodePtr>;
+    using NodePool = MeltiCache::NodePool<NodeType>;
+    using Slot = MeltiCache::SlotIndex;
+    using NodeMap = MeltiCache::FlatIndex<Key>;
 
   private:
-    int mainCapacity_;   // total cache capacity
-    int ghostCapacity_;  // ghost list capacity
-    int transformNeed_;  // when access number over the need ,transfer to Lfu part
+    size_t mainCapacity_;   // capacity of the main list, in weight units (entries without a weigher)
+    size_t weightedSize_;   // total weight of the main list
+    size_t evictions_;      // capacity evictions to the ghost list, for ArcCache's stats
+    int transformNeed_;     // when access number over the need ,transfer to Lfu part
+    NodePool pool_;      // main nodes only, evicted slots are recycled
     NodeMap mainCache_;
-    NodeMap ghostCache_;
-    NodePtr mainHead_;
-    NodePtr mainTail_;
-    NodePtr ghostHead_;
-    NodePtr ghostTail_;
+    MeltiCache::GhostList<Key> ghost_;  // fingerprints of recently evicted keys, same capacity as the main list
+    Slot mainHead_;
+    Slot mainTail_;
+    MeltiCache::TimerWheel wheel_;  // expiry of main entries, armed by ArcCache
 
   public:
-    ArcLru(int capacity, int transformNeed)
-        : mainCapacity_(capacity), transformNeed_((transformNeed)), ghostCapacity_(capacity)
+    // weighted: capacity is a weight budget, so the entry count is unknown and the pool grows on demand
+    ArcLru(size_t capacity, int transformNeed, bool weighted = false)
+        : mainCapacity_(capacity),
+          weightedSize_(0),
+          evictions_(0),
+          transformNeed_((transformNeed)),
+          pool_(weighted ? 2 : capacity + 2),
+          ghost_(capacity, weighted)
     {
+        if (!weighted) mainCache_.reserve(capacity);
         initialize();
     }
-    bool put(Key key, Value value)
+    // K/V are forwarding references: rvalues are moved all the way into the pooled node
+    // weight is the entry's weight as computed by ArcCache's weigher; returns the entry's slot, or kNullSlot
+    // when it was not cached
+    template <typename K, typename V>
+    Slot put(K &&key, V &&value, size_t weight = 1)
     {
-        if (mainCapacity_ == 0) return false;
-        auto it = mainCache_.find(key);
-        if (it != mainCache_.end())
+        uint64_t hash = mainCache_.hash(key);
+        return put(std::forward<K>(key), std::forward<V>(value), weight, hash);
+    }
+
+    // hash is MeltiCache::Hasher of the key, computed once by ArcCache
+    template <typename K, typename V>
+    Slot put(K &&key, V &&value, size_t weight, uint64_t hash)
+    {
+        if (mainCapacity_ == 0) return MeltiCache::kNullSlot;
+        Slot slot = findSlot(key, hash);
+        if (slot != MeltiCache::kNullSlot)
         {
-            return updateExistingNode(it->second, value);
+            return updateExistingNode(slot, std::forward<V>(value), weight);
         }
-        return addNewNode(key, value);
+        return addNewNode(std::forward<K>(key), std::forward<V>(value), weight, hash);
     }
 
-    void remove(Key key)
+    void remove(const Key &key)
     {
-        auto it = mainCache_.find(key);
-        if (it != mainCache_.end())
+        Slot slot = findSlot(key, mainCache_.hash(key));
+        if (slot != MeltiCache::kNullSlot)
         {
-            removeNode(it->second);
-            mainCache_.erase(it);
+            removeEntry(slot);
         }
     }
 
+    // drops the entry in this slot, e.g. after it was promoted to the LFU part
+    void removeAt(Slot slot) { removeEntry(slot); }
+
     // 返回一个bool来让后期的ARC判断是否需要把Node转换到LFU中
-    bool get(Key key, Value &value, bool &NeedTransform)
+    bool get(const Key &key, Value &value, bool &NeedTransform)
     {
-        auto it = mainCache_.find(key);
-        if (it != mainCache_.end())
+        Slot slot = findSlot(key, mainCache_.hash(key));
+        if (slot != MeltiCache::kNullSlot)
         {
-            NeedTransform = updateNodeAccess(it->second);
-            value = it->second->getValue();
+            NeedTransform = updateNodeAccess(slot);
+            value = pool_[slot].value_;
             return true;
         }
         return false;
     }
 
-    bool ghostContain(Key key)
+    // Lookup without touching the recency list, safe for concurrent readers under ArcCache's shared lock.
+    // The access is recorded separately and replayed through recordAccess().
+    bool find(const Key &key, uint64_t hash, Slot &slot) const
     {
-        auto it = ghostCache_.find(key);
-        return it != ghostCache_.end();
+        slot = findSlot(key, hash);
+        return slot != MeltiCache::kNullSlot;
     }
+    const Value &valueOf(Slot slot) const { return pool_[slot].value_; }
+    const Key &keyOf(Slot slot) const { return pool_[slot].key_; }
+    uint32_t stampOf(Slot slot) const { return pool_[slot].stamp_; }
+    size_t weightOf(Slot slot) const { return pool_[slot].weight_; }
+    uint64_t hashOf(Slot slot) const { return pool_[slot].hash_; }
+    MeltiCache::ValueHandle<Value> pin(Slot slot) const { return {&pool_[slot].value_, &pool_.pins(slot)}; }
+    void prefetch(Slot slot) const { pool_.prefetch(slot); }
 
-    void decreaseCapacity()
+    // Expiry of main entries. Deadlines are absolute TimerWheel::now() nanoseconds, 0 means none;
+    // entries leaving the main list drop their timer, ghosts never expire.
+    void setDeadline(Slot slot, uint64_t deadline) { wheel_.schedule(slot, deadline); }
+    uint64_t deadlineOf(Slot slot) const { return wheel_.deadlineOf(slot); }
+    bool expired(Slot slot, uint64_t now) const { return wheel_.expired(slot, now); }
+    // time of the entry's last write, kept by ArcCache for refresh-ahead
+    void setWrittenAt(Slot slot, uint64_t now) { pool_[slot].writtenAt_ = now; }
+    uint64_t writtenAtOf(Slot slot) const { return pool_[slot].writtenAt_; }
+    // drops every due entry, without sending it to the ghost list; returns how many
+    size_t expire(uint64_t now)
     {
-        if (mainCache_.size() == mainCapacity_)
+        size_t expired = 0;
+        wheel_.advance(now, [this, &expired](Slot slot) {
+            removeEntry(slot);
+            ++expired;
+        });
+        return expired;
+    }
+
+    // Replays a buffered read. Returns false if the slot no longer holds the entry that was read.
+    bool recordAccess(Slot slot, uint32_t stamp, bool &NeedTransform)
+    {
+        if (pool_[slot].stamp_ != stamp) return false;
+        NeedTransform = updateNodeAccess(slot);
+        return true;
+    }
+
+    bool ghostContain(uint64_t hash) const { return ghost_.containsHash(hash); }
+
+    // ARC adaptation, delta is in weight units. Gives up at most the whole budget and returns how much it gave,
+    // which is all the other part may take, so the two budgets always add up to the same total.
+    size_t decreaseCapacity(size_t delta)
+    {
+        size_t given = std::min(delta, mainCapacity_);
+        mainCapacity_ -= given;
+        while (weightedSize_ > mainCapacity_)
         {
             evictLeastRecent();
         }
-        --mainCapacity_;
+        return given;
     }
-    void increaseCapacity() { ++mainCapacity_; }
+    void increaseCapacity(size_t delta) { mainCapacity_ += delta; }
+    // whether an entry of this weight can be stored at the current budget
+    bool fits(size_t weight) const { return mainCapacity_ != 0 && weight <= mainCapacity_; }
+
+    // Snapshot support. forEachEntry visits the main list from least to most recently used, fn(slot);
+    // restoring the entries in that order into an empty part rebuilds the recency order.
+    template <typename Fn>
+    void forEachEntry(Fn &&fn) const
+    {
+        for (Slot slot = pool_[mainTail_].pre_; slot != mainHead_; slot = pool_[slot].pre_)
+        {
+            fn(slot);
+        }
+    }
+    size_t accessCountOf(Slot slot) const { return pool_[slot].accessCount_; }
+    template <typename Fn>
+    void forEachGhost(Fn &&fn) const
+    {
+        ghost_.forEach(std::forward<Fn>(fn));
+    }
+    void restoreCapacity(size_t capacity) { mainCapacity_ = capacity; }
+    // inserts as the most recent entry, never evicts: returns kNullSlot when the entry does not fit
+    template <typename K, typename V>
+    Slot restore(K &&key, V &&value, size_t weight, uint64_t hash, size_t accessCount)
+    {
+        if (weightedSize_ + weight > mainCapacity_ || findSlot(key, hash) != MeltiCache::kNullSlot)
+        {
+            return MeltiCache::kNullSlot;
+        }
+        Slot slot = addNewNode(std::forward<K>(key), std::forward<V>(value), weight, hash);
+        pool_[slot].accessCount_ = accessCount;
+        return slot;
+    }
+    void restoreGhost(uint64_t hash, size_t weight) { ghost_.pushHash(hash, weight); }
+
+    size_t weightedSize() const { return weightedSize_; }
+    size_t capacity() const { return mainCapacity_; }
+    size_t evictions() const { return evictions_; }
 
   private:
+    // slot of the key in the main list, kNullSlot if absent; keys are compared against the pooled nodes
+    Slot findSlot(const Key &key, uint64_t hash) const
+    {
+        return mainCache_.find(hash, [&](Slot slot) { return pool_[slot].key_ == key; });
+    }
     void initialize()
     {
-        mainHead_ = std::make_shared<NodeType>();
-        mainTail_ = std::make_shared<NodeType>();
-        mainHead_->next_ = mainTail_;
-        mainTail_->pre_ = mainHead_;
-
-        ghostHead_ = std::make_shared<NodeType>();
-        ghostTail_ = std::make_shared<NodeType>();
-        ghostHead_->next_ = ghostTail_;
-        ghostTail_->pre_ = ghostHead_;
+        mainHead_ = pool_.allocate();
+        mainTail_ = pool_.allocate();
+        pool_[mainHead_].next_ = mainTail_;
+        pool_[mainTail_].pre_ = mainHead_;
     }
-    bool updateExistingNode(NodePtr node, Value &value)
+    template <typename V>
+    Slot updateExistingNode(Slot node, V &&value, size_t weight)
     {
-        node->setValue(value);
-        node->incrementAccessCount();
+        if (weight > mainCapacity_)
+        {
+            // the new value alone does not fit, drop the entry
+            removeEntry(node);
+            return MeltiCache::kNullSlot;
+        }
+        if (pool_.isPinned(node))
+        {
+            node = replacePinnedNode(node);
+        }
+        pool_[node].setValue(std::forward<V>(value));
+        weightedSize_ = weightedSize_ - pool_[node].weight_ + weight;
+        pool_[node].weight_ = weight;
+        pool_[node].incrementAccessCount();
         moveToFront(node);
-        return true;
+        // a heavier value may overflow the budget; the node is at the front, so it is not the victim
+        while (weightedSize_ > mainCapacity_)
+        {
+            evictLeastRecent();
+        }
+        return node;
+    }
+    // A handle still reads the old value: put a fresh node in its place instead of overwriting it.
+    Slot replacePinnedNode(Slot old)
+    {
+        Slot node = pool_.allocate();
+        NodeType &cur = pool_[node];
+        NodeType &prev = pool_[old];
+        cur.key_ = prev.key_;
+        cur.accessCount_ = prev.accessCount_;
+        cur.weight_ = prev.weight_;
+        cur.hash_ = prev.hash_;
+        cur.writtenAt_ = prev.writtenAt_;
+        cur.pre_ = prev.pre_;
+        cur.next_ = prev.next_;
+        pool_[cur.pre_].next_ = node;
+        pool_[cur.next_].pre_ = node;
+        prev.next_ = MeltiCache::kNullSlot;
+        ++prev.stamp_;
+        mainCache_.replace(cur.hash_, old, node);
+        uint64_t deadline = wheel_.deadlineOf(old);
+        wheel_.deschedule(old);
+        wheel_.schedule(node, deadline);
+        pool_.release(old);  // pinned, so its value stays for the handle
+        return node;
     }
-    bool updateNodeAccess(NodePtr node)
+    bool updateNodeAccess(Slot node)
     {
         moveToFront(node);
-        node->accessCount_++;
-        return node->getAccessCount() >= transformNeed_;
+        pool_[node].accessCount_++;
+        return pool_[node].getAccessCount() >= static_cast<size_t>(transformNeed_);
     }
-    bool addNewNode(Key key, Value &value)
+    template <typename K, typename V>
+    Slot addNewNode(K &&key, V &&value, size_t weight, uint64_t hash)
     {
-        if (mainCache_.size() >= mainCapacity_)
+        if (weight > mainCapacity_) return MeltiCache::kNullSlot;
+        while (weightedSize_ + weight > mainCapacity_)
         {
             evictLeastRecent();
         }
-        auto newNode = std::make_shared<NodeType>(key, value);
-        mainCache_[key] = newNode;
+        Slot newNode = pool_.allocate();
+        NodeType &node = pool_[newNode];
+        mainCache_.insert(hash, newNode);
+        node.key_ = std::forward<K>(key);
+        node.hash_ = hash;
+        node.writtenAt_ = 0;
+        node.value_ = std::forward<V>(value);
+        node.accessCount_ = 1;
+        node.weight_ = weight;
+        weightedSize_ += weight;
         addToFront(newNode);
-        return true;
+        return newNode;
     }
-    void moveToFront(NodePtr node)
+    void moveToFront(Slot node)
     {
         removeNode(node);
         addToFront(node);
     }
-    void addToFront(NodePtr node)
+    void linkAfter(Slot head, Slot node)
     {
-        node->pre_ = mainHead_;
-        node->next_ = mainHead_->next_;
-        mainHead_->next_->pre_ = node;
-        mainHead_->next_ = node;
+        NodeType &cur = pool_[node];
+        cur.pre_ = head;
+        cur.next_ = pool_[head].next_;
+        pool_[cur.next_].pre_ = node;
+        pool_[head].next_ = node;
     }
-    void addToGhostFront(NodePtr node)
+    void addToFront(Slot node) { linkAfter(mainHead_, node); }
+    void removeNode(Slot node)
     {
-        node->pre_ = ghostHead_;
-        node->next_ = ghostHead_->next_;
-        ghostHead_->next_->pre_ = node;
-        ghostHead_->next_ = node;
+        NodeType &cur = pool_[node];
+        pool_[cur.pre_].next_ = cur.next_;
+        pool_[cur.next_].pre_ = cur.pre_;
+        cur.next_ = MeltiCache::kNullSlot;
     }
-    void removeNode(NodePtr node)
+    void removeEntry(Slot node)
     {
-        auto preNode = node->pre_.lock();
-        preNode->next_ = node->next_;
-        node->next_->pre_ = preNode;
-        node->next_ = nullptr;
+        removeNode(node);
+        weightedSize_ -= pool_[node].weight_;
+        ++pool_[node].stamp_;
+        wheel_.deschedule(node);
+        mainCache_.erase(pool_[node].hash_, node);
+        releaseNode(node);
     }
-    void removeOldestGhost()
+    // the value is freed now rather than when the slot is reused, unless a handle still reads it
+    void releaseNode(Slot node)
     {
-        auto lastGhostNode = ghostTail_->pre_.lock();
-        removeNode(lastGhostNode);
-        ghostCache_.erase(lastGhostNode->getKey());
+        if (!pool_.isPinned(node)) pool_[node].clear();
+        pool_.release(node);
     }
     void evictLeastRecent()
     {
-        auto lastNode = mainTail_->pre_.lock();
+        Slot lastNode = pool_[mainTail_].pre_;
+        if (lastNode == mainHead_) return;
         removeNode(lastNode);
-        mainCache_.erase(lastNode->getKey());
-        if (ghostCache_.size() >= ghostCapacity_)
-        {
-            removeOldestGhost();
-        }
-        addToGhostFront(lastNode);
-        ghostCache_[lastNode->getKey()] = lastNode;
+        ++pool_[lastNode].stamp_;
+        wheel_.deschedule(lastNode);
+        weightedSize_ -= pool_[lastNode].weight_;
+        mainCache_.erase(pool_[lastNode].hash_, lastNode);
+        ghost_.pushHash(pool_[lastNode].hash_, pool_[lastNode].weight_);
+        releaseNode(lastNode);
+        ++evictions_;
     }
-};
\ No newline at end of file
+};
@@ -1,6 +1,10 @@
 #pragma once
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <utility>
+
+#include "NodePool.h"
 template <typename Key, typename Value>
 class ArcNode
 {
@@ -8,20 +12,33 @@ class ArcNode
     Key key_;
     Value value_;
     size_t accessCount_;  // 访问次数
-    std::shared_ptr<ArcNode> next_;
-    std::weak_ptr<ArcNode> pre_;
+    size_t weight_;       // weight charged to the owning list, 1 without a weigher
+    uint64_t hash_;       // MeltiCache::Hasher of the key, so eviction and ghost insertion never rehash
+    uint64_t writtenAt_;  // TimerWheel::now() of the last write while refresh-ahead is on, 0 otherwise
+    MeltiCache::SlotIndex next_;  // slot of the neighbour nodes in the owner's pool
+    MeltiCache::SlotIndex pre_;
+    uint32_t bucket_;             // frequency bucket while the node sits in ArcLfu
+    uint32_t stamp_;              // bumped when the node leaves a main list, so stale buffered reads are ignored
 
   public:
-    ArcNode() : accessCount_(1), next_(nullptr) {}
-    ArcNode(Key key, Value value) : accessCount_(1), key_(key), value_(value), next_(nullptr) {}
-    void setValue(Value value) { value_ = value; }
-    Value getValue() { return value_; }
-    Key getKey() { return key_; }
+    ArcNode() : key_(), value_(), accessCount_(1), weight_(1), hash_(0), writtenAt_(0), next_(MeltiCache::kNullSlot), pre_(MeltiCache::kNullSlot), bucket_(0), stamp_(0)
+    {
+    }
+    void setValue(const Value &value) { value_ = value; }
+    void setValue(Value &&value) { value_ = std::move(value); }
+    const Value &getValue() const { return value_; }
+    const Key &getKey() const { return key_; }
     size_t getAccessCount() { return accessCount_; }
     void incrementAccessCount() { accessCount_++; }
+    // frees what key and value own when the slot goes back to the pool; the node object itself is reused
+    void clear()
+    {
+        key_ = Key();
+        value_ = Value();
+    }
 
     template <typename K, typename V>
     friend class ArcLru;
     template <typename K, typename V>
     friend class ArcLfu;
-};
\ No newline at end of file
+};
@@ -0,0 +1,424 @@
+// Multi-threaded benchmark over the cache policies.
+//
+//   g++ -std=c++17 -O2 -DNDEBUG Benchmark.cc -o bench -pthread
+//   ./bench --policies=lru,arc --workloads=zipf,scan --threads=1,2,4,8 --value-sizes=16,1024 --format=json
+//
+// Every (policy, workload, threads, value size) combination gets a fresh cache. Each thread replays its own
+// pre-generated key stream as a read-through client: get, and put the value on a miss. The first
+// --warmup-ops of every stream fill the cache untimed, the rest is timed op by op. One line per run is
+// printed, CSV (with a header) or JSON lines, with ops/sec, hit ratio and p50/p99/p999 latency in ns.
+// Every policy holds at most --capacity entries; ArcCache is built with half of it, since its LRU and LFU parts
+// each get the capacity it is constructed with.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ArcCache.h"
+#include "CacheBuilder.h"
+#include "ClockCache.h"
+#include "Hasher.h"
+#include "LFUCache.h"
+#include "LRUCache.h"
+#include "LirsCache.h"
+#include "S3FifoCache.h"
+#include "ShardedCache.h"
+#include "TinyLfuCache.h"
+
+using namespace std;
+
+namespace
+{
+    using Key = uint64_t;
+    using Value = string;
+    using Cache = MeltiCache::ICachePolicy<Key, Value>;
+
+    struct Options
+    {
+        vector<string> policies{"lru", "klru", "hashlru", "lfu", "arc"};
+        vector<string> workloads{"zipf", "uniform", "scan", "loop", "shift", "mixed"};
+        vector<size_t> threads;
+        vector<size_t> valueSizes{16, 1024};
+        size_t keys = 1 << 20;
+        size_t capacity = 0;  // 0: keys / 10
+        size_t ops = 1 << 20;  // timed ops per thread
+        size_t warmupOps = 0;  // 0: 2 * capacity, split over the threads
+        double theta = 0.99;
+        unsigned writePercent = 0;  // extra blind puts on top of the read-through fills
+        uint64_t seed = 1;
+        string format = "csv";
+    };
+
+    // Zipf ranks in [0, n) with the YCSB generator (Gray et al., "Quickly Generating Billion-Record
+    // Synthetic Databases", SIGMOD 1994): zeta(n) is summed once, each draw is one pow().
+    class Zipf
+    {
+      public:
+        Zipf(size_t n, double theta) : n_(n), theta_(theta)
+        {
+            double zeta2 = 1.0 + std::pow(0.5, theta);
+            for (size_t i = 1; i <= n; ++i)
+            {
+                zetaN_ += 1.0 / std::pow(static_cast<double>(i), theta);
+            }
+            alpha_ = 1.0 / (1.0 - theta);
+            eta_ = (1.0 - std::pow(2.0 / static_cast<double>(n), 1.0 - theta)) / (1.0 - zeta2 / zetaN_);
+        }
+
+        template <typename Rng>
+        size_t operator()(Rng &rng) const
+        {
+            double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+            double uz = u * zetaN_;
+            if (uz < 1.0) return 0;
+            if (uz < 1.0 + std::pow(0.5, theta_)) return 1;
+            size_t rank = static_cast<size_t>(static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+            return rank < n_ ? rank : n_ - 1;
+        }
+
+      private:
+        size_t n_;
+        double theta_;
+        double zetaN_ = 0.0;
+        double alpha_;
+        double eta_;
+    };
+
+    // Key stream of one thread: warmup ops followed by timed ops.
+    // zipf     Zipf(theta) ranks, scrambled so the hot keys are not neighbours
+    // uniform  uniform over all keys
+    // scan     one sequential pass over the key space, threads start at evenly spaced offsets
+    // loop     a loop over 1.25x capacity keys, the pattern where LRU hits nothing
+    // shift    90% uniform over a hot set of capacity / 2 keys that moves every quarter of the run
+    // mixed    zipf, interrupted every 1000 ops by a 200-key scan of cold keys
+    vector<Key> makeStream(const string &workload, const Options &options, const Zipf *zipf, size_t thread,
+                           size_t threadCount, size_t length)
+    {
+        mt19937_64 rng(options.seed * 1000003 + thread);
+        size_t keys = options.keys;
+        auto scrambled = [&](size_t rank) { return MeltiCache::mix64(rank) % keys; };
+        vector<Key> stream(length);
+        if (workload == "zipf")
+        {
+            for (Key &key : stream) key = scrambled((*zipf)(rng));
+        }
+        else if (workload == "uniform")
+        {
+            for (Key &key : stream) key = rng() % keys;
+        }
+        else if (workload == "scan")
+        {
+            size_t next = keys / threadCount * thread;
+            for (Key &key : stream) key = next++ % keys;
+        }
+        else if (workload == "loop")
+        {
+            size_t loop = max<size_t>(options.capacity + options.capacity / 4, 1);
+            for (size_t i = 0; i < length; ++i) stream[i] = i % loop;
+        }
+        else if (workload == "shift")
+        {
+            size_t hot = max<size_t>(options.capacity / 2, 1);
+            size_t phase = max<size_t>(length / 4, 1);
+            for (size_t i = 0; i < length; ++i)
+            {
+                size_t base = (i / phase) * hot;
+                stream[i] = rng() % 10 ? (base + rng() % hot) % keys : rng() % keys;
+            }
+        }
+        else if (workload == "mixed")
+        {
+            size_t cold = keys / threadCount * thread;
+            for (size_t i = 0; i < length; ++i)
+            {
+                stream[i] = i % 1200 < 1000 ? scrambled((*zipf)(rng)) : cold++ % keys;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "unknown workload: %s\n", workload.c_str());
+            exit(2);
+        }
+        return stream;
+    }
+
+    unique_ptr<Cache> makeCache(const string &policy, size_t capacity)
+    {
+        int cap = static_cast<int>(capacity);
+        if (policy == "lru") return make_unique<LruCache<Key, Value>>(cap);
+        if (policy == "klru") return make_unique<KLruCache<Key, Value>>(cap, cap, 2);
+        if (policy == "hashlru") return make_unique<HashLruCache<Key, Value>>(cap, 0);
+        if (policy == "lfu") return make_unique<LfuCache<Key, Value>>(cap, 10);
+        // ArcCache gives its LRU and LFU parts `capacity` each, half of it keeps ARC at the same entry budget
+        size_t arcCapacity = max<size_t>(capacity / 2, 1);
+        if (policy == "arc") return make_unique<ArcCache<Key, Value>>(arcCapacity, 2);
+        if (policy == "sharded-arc")
+            return make_unique<ShardedCache<Key, Value, ArcCache<Key, Value>>>(arcCapacity, 0, 2);
+        if (policy == "clock") return make_unique<ClockCache<Key, Value>>(cap);
+        if (policy == "clockpro") return make_unique<ClockProCache<Key, Value>>(cap);
+        if (policy == "lirs") return make_unique<LirsCache<Key, Value>>(cap);
+        if (policy == "s3fifo") return make_unique<S3FifoCache<Key, Value>>(cap);
+        if (policy == "tinylfu") return make_unique<TinyLfuCache<Key, Value>>(cap);
+        // compile-time composed caches, driven through the ICachePolicy adapter like the others
+        if (policy == "built-lru") return make_unique<MeltiCache::CacheBuilder<Key, Value>::Policy>(capacity);
+        if (policy == "built-clock")
+        {
+            using Builder =
+                MeltiCache::CacheBuilder<Key, Value>::Lock<shared_mutex>::Eviction<MeltiCache::ClockEviction>;
+            return make_unique<Builder::Policy>(capacity);
+        }
+        fprintf(stderr, "unknown policy: %s\n", policy.c_str());
+        exit(2);
+    }
+
+    struct ThreadResult
+    {
+        size_t hits = 0;
+        size_t gets = 0;
+        vector<uint32_t> latencies;  // ns per op, saturated at 4 s
+    };
+
+    struct RunResult
+    {
+        double seconds;
+        size_t ops;
+        size_t hits;
+        size_t gets;
+        uint32_t p50;
+        uint32_t p99;
+        uint32_t p999;
+    };
+
+    uint32_t percentile(const vector<uint32_t> &sorted, double p)
+    {
+        if (sorted.empty()) return 0;
+        size_t at = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+        return sorted[at];
+    }
+
+    RunResult run(Cache &cache, const vector<vector<Key>> &streams, const Options &options, size_t warmup,
+                  size_t valueSize)
+    {
+        size_t threadCount = streams.size();
+        const Value prototype(valueSize, 'v');
+        vector<ThreadResult> results(threadCount);
+        atomic<size_t> ready{0};
+        atomic<bool> go{false};
+        chrono::steady_clock::time_point start;
+        chrono::steady_clock::time_point stop;
+        atomic<size_t> done{0};
+
+        auto worker = [&](size_t t) {
+            const vector<Key> &stream = streams[t];
+            ThreadResult &result = results[t];
+            mt19937 rng(static_cast<uint32_t>(options.seed + t));
+            Value value;
+            for (size_t i = 0; i < warmup; ++i)
+            {
+                if (!cache.get(stream[i], value)) cache.put(stream[i], prototype);
+            }
+            ready.fetch_add(1);
+            while (!go.load(memory_order_acquire))
+            {
+                this_thread::yield();
+            }
+            result.latencies.reserve(stream.size() - warmup);
+            for (size_t i = warmup; i < stream.size(); ++i)
+            {
+                auto before = chrono::steady_clock::now();
+                if (options.writePercent && rng() % 100 < options.writePercent)
+                {
+                    cache.put(stream[i], prototype);
+                }
+                else
+                {
+                    ++result.gets;
+                    if (cache.get(stream[i], value))
+                    {
+                        ++result.hits;
+                    }
+                    else
+                    {
+                        cache.put(stream[i], prototype);
+                    }
+                }
+                auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - before).count();
+                result.latencies.push_back(static_cast<uint32_t>(min<long long>(ns, 4000000000LL)));
+            }
+            if (done.fetch_add(1) + 1 == threadCount) stop = chrono::steady_clock::now();
+        };
+
+        vector<thread> threads;
+        for (size_t t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back(worker, t);
+        }
+        while (ready.load() != threadCount)
+        {
+            this_thread::yield();
+        }
+        start = chrono::steady_clock::now();
+        go.store(true, memory_order_release);
+        for (thread &th : threads)
+        {
+            th.join();
+        }
+
+        RunResult result{};
+        result.seconds = chrono::duration<double>(stop - start).count();
+        vector<uint32_t> latencies;
+        for (ThreadResult &r : results)
+        {
+            result.hits += r.hits;
+            result.gets += r.gets;
+            latencies.insert(latencies.end(), r.latencies.begin(), r.latencies.end());
+        }
+        result.ops = latencies.size();
+        sort(latencies.begin(), latencies.end());
+        result.p50 = percentile(latencies, 0.50);
+        result.p99 = percentile(latencies, 0.99);
+        result.p999 = percentile(latencies, 0.999);
+        return result;
+    }
+
+    void report(const Options &options, const string &policy, const string &workload, size_t threads,
+                size_t valueSize, const RunResult &r)
+    {
+        double opsPerSec = r.seconds > 0 ? static_cast<double>(r.ops) / r.seconds : 0.0;
+        double hitRatio = r.gets ? static_cast<double>(r.hits) / static_cast<double>(r.gets) : 0.0;
+        if (options.format == "json")
+        {
+            printf("{\"policy\":\"%s\",\"workload\":\"%s\",\"threads\":%zu,\"value_size\":%zu,\"capacity\":%zu,"
+                   "\"keys\":%zu,\"ops\":%zu,\"seconds\":%.6f,\"ops_per_sec\":%.0f,\"hit_ratio\":%.6f,"
+                   "\"p50_ns\":%u,\"p99_ns\":%u,\"p999_ns\":%u}\n",
+                   policy.c_str(), workload.c_str(), threads, valueSize, options.capacity, options.keys, r.ops,
+                   r.seconds, opsPerSec, hitRatio, r.p50, r.p99, r.p999);
+        }
+        else
+        {
+            printf("%s,%s,%zu,%zu,%zu,%zu,%zu,%.6f,%.0f,%.6f,%u,%u,%u\n", policy.c_str(), workload.c_str(), threads,
+                   valueSize, options.capacity, options.keys, r.ops, r.seconds, opsPerSec, hitRatio, r.p50, r.p99,
+                   r.p999);
+        }
+        fflush(stdout);
+    }
+
+    vector<string> splitList(const string &text)
+    {
+        vector<string> items;
+        stringstream in(text);
+        string item;
+        while (getline(in, item, ','))
+        {
+            if (!item.empty()) items.push_back(item);
+        }
+        return items;
+    }
+
+    vector<size_t> splitNumbers(const string &text)
+    {
+        vector<size_t> numbers;
+        for (const string &item : splitList(text))
+        {
+            numbers.push_back(static_cast<size_t>(stoull(item)));
+        }
+        return numbers;
+    }
+
+    void usage()
+    {
+        fprintf(stderr,
+                "usage: bench [--policies=lru,klru,hashlru,lfu,arc,sharded-arc,clock,clockpro,lirs,\n"
+                "               s3fifo,tinylfu,built-lru,built-clock]\n"
+                "             [--workloads=zipf,uniform,scan,loop,shift,mixed] [--threads=1,2,4]\n"
+                "             [--value-sizes=16,1024] [--keys=N] [--capacity=N] [--ops=N] [--warmup-ops=N]\n"
+                "             [--theta=0.99] [--write-percent=P] [--seed=N] [--format=csv|json]\n"
+                "--capacity is the entry budget of every policy; arc and sharded-arc get capacity / 2 per LRU/LFU part\n");
+        exit(2);
+    }
+
+    Options parse(int argc, char **argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; ++i)
+        {
+            string arg = argv[i];
+            size_t eq = arg.find('=');
+            if (arg.compare(0, 2, "--") != 0 || eq == string::npos) usage();
+            string name = arg.substr(2, eq - 2);
+            string value = arg.substr(eq + 1);
+            if (name == "policies") options.policies = splitList(value);
+            else if (name == "workloads") options.workloads = splitList(value);
+            else if (name == "threads") options.threads = splitNumbers(value);
+            else if (name == "value-sizes") options.valueSizes = splitNumbers(value);
+            else if (name == "keys") options.keys = stoull(value);
+            else if (name == "capacity") options.capacity = stoull(value);
+            else if (name == "ops") options.ops = stoull(value);
+            else if (name == "warmup-ops") options.warmupOps = stoull(value);
+            else if (name == "theta") options.theta = stod(value);
+            else if (name == "write-percent") options.writePercent = static_cast<unsigned>(stoul(value));
+            else if (name == "seed") options.seed = stoull(value);
+            else if (name == "format") options.format = value;
+            else usage();
+        }
+        if (options.keys == 0 || options.theta <= 0.0 || options.theta >= 1.0 || options.writePercent > 100 ||
+            (options.format != "csv" && options.format != "json"))
+        {
+            usage();
+        }
+        if (options.capacity == 0) options.capacity = max<size_t>(options.keys / 10, 1);
+        if (options.threads.empty())
+        {
+            // 1, 2, 4 ... up to the core count
+            size_t cores = max<unsigned>(thread::hardware_concurrency(), 1);
+            for (size_t t = 1; t < cores; t *= 2) options.threads.push_back(t);
+            options.threads.push_back(cores);
+        }
+        return options;
+    }
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    Options options = parse(argc, argv);
+    Zipf zipf(options.keys, options.theta);
+    if (options.format == "csv")
+    {
+        printf("policy,workload,threads,value_size,capacity,keys,ops,seconds,ops_per_sec,hit_ratio,p50_ns,p99_ns,"
+               "p999_ns\n");
+    }
+    for (const string &workload : options.workloads)
+    {
+        for (size_t threadCount : options.threads)
+        {
+            if (threadCount == 0) continue;
+            size_t warmup = options.warmupOps ? options.warmupOps : 2 * options.capacity / threadCount;
+            // streams depend on the workload and thread count only, every policy replays the same keys
+            vector<vector<Key>> streams;
+            for (size_t t = 0; t < threadCount; ++t)
+            {
+                streams.push_back(makeStream(workload, options, &zipf, t, threadCount, warmup + options.ops));
+            }
+            for (size_t valueSize : options.valueSizes)
+            {
+                for (const string &policy : options.policies)
+                {
+                    unique_ptr<Cache> cache = makeCache(policy, options.capacity);
+                    RunResult result = run(*cache, streams, options, warmup, valueSize);
+                    report(options, policy, workload, threadCount, valueSize, result);
+                }
+            }
+        }
+    }
+    return 0;
+}
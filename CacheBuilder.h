@@ -0,0 +1,594 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "CacheStats.h"
+#include "FlatIndex.h"
+#include "Hasher.h"
+#include "ICachePolicy.h"
+#include "NodePool.h"
+#include "TimerWheel.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Compile-time composed caches. Every choice the virtual policies make at run time (or not at all) is a
+// template parameter here: the hasher, the lock, the node allocator, the eviction policy, and whether stats
+// and expiry exist. BasicCache has no virtual functions and branches on its configuration only through
+// if constexpr, so
+//
+//   using Cache = MeltiCache::CacheBuilder<int, std::string>::Lock<MeltiCache::NoLock>::Stats<false>::Cache;
+//
+// is a single-threaded LRU whose get/put inline down to a hash, an index probe and a list splice, with no
+// atomic, lock or counter left in them. CacheBuilder<...>::Policy wraps the same cache in ICachePolicy for
+// code that wants the type-erased interface.
+namespace MeltiCache
+{
+    // ---- locks ----
+
+    // for caches owned by one thread: every member is empty and disappears after inlining
+    struct NoLock
+    {
+        void lock() {}
+        void unlock() {}
+        void lock_shared() {}
+        void unlock_shared() {}
+    };
+
+    // Test-and-test-and-set spinlock for short critical sections under low contention. Readers take it
+    // exclusively too.
+    class SpinLock
+    {
+      public:
+        void lock()
+        {
+            while (locked_.exchange(true, std::memory_order_acquire))
+            {
+                while (locked_.load(std::memory_order_relaxed))
+                {
+                    pause();
+                }
+            }
+        }
+
+        void unlock() { locked_.store(false, std::memory_order_release); }
+
+      private:
+        static void pause()
+        {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+            _mm_pause();
+#endif
+        }
+
+        std::atomic<bool> locked_{false};
+    };
+
+    // Locks with lock_shared() (std::shared_mutex) let gets whose eviction policy does not write on a hit run
+    // concurrently; any other lock is taken exclusively.
+    template <typename Lock, typename = void>
+    struct HasSharedLock : std::false_type
+    {
+    };
+
+    template <typename Lock>
+    struct HasSharedLock<Lock, decltype(std::declval<Lock &>().lock_shared())> : std::true_type
+    {
+    };
+
+    // ---- eviction policies ----
+    // An eviction policy tracks the slots of a BasicCache and picks victims. It keeps its own per-slot state,
+    // sized once by reserve(), and runs under the cache's exclusive lock, except onAccess() when
+    // kReadOnlyAccess says it is safe under a shared lock.
+
+    // Doubly-linked list of slots in two parallel arrays, most recent at the front.
+    class SlotList
+    {
+      public:
+        void reserve(size_t slots)
+        {
+            prev_.assign(slots + 1, kNullSlot);
+            next_.assign(slots + 1, kNullSlot);
+            head_ = static_cast<SlotIndex>(slots);  // sentinel
+            prev_[head_] = head_;
+            next_[head_] = head_;
+        }
+
+        void pushFront(SlotIndex slot)
+        {
+            prev_[slot] = head_;
+            next_[slot] = next_[head_];
+            prev_[next_[head_]] = slot;
+            next_[head_] = slot;
+        }
+
+        void unlink(SlotIndex slot)
+        {
+            next_[prev_[slot]] = next_[slot];
+            prev_[next_[slot]] = prev_[slot];
+        }
+
+        SlotIndex back() const { return prev_[head_] == head_ ? kNullSlot : prev_[head_]; }
+
+      private:
+        std::vector<SlotIndex> prev_;
+        std::vector<SlotIndex> next_;
+        SlotIndex head_ = 0;
+    };
+
+    class LruEviction
+    {
+      public:
+        static constexpr bool kReadOnlyAccess = false;
+
+        void reserve(size_t slots) { list_.reserve(slots); }
+        void onInsert(SlotIndex slot) { list_.pushFront(slot); }
+        void onAccess(SlotIndex slot)
+        {
+            list_.unlink(slot);
+            list_.pushFront(slot);
+        }
+        void onRemove(SlotIndex slot) { list_.unlink(slot); }
+        SlotIndex victim() { return list_.back(); }
+
+      private:
+        SlotList list_;
+    };
+
+    // insertion order, hits change nothing
+    class FifoEviction
+    {
+      public:
+        static constexpr bool kReadOnlyAccess = true;
+
+        void reserve(size_t slots) { list_.reserve(slots); }
+        void onInsert(SlotIndex slot) { list_.pushFront(slot); }
+        void onAccess(SlotIndex) const {}
+        void onRemove(SlotIndex slot) { list_.unlink(slot); }
+        SlotIndex victim() { return list_.back(); }
+
+      private:
+        SlotList list_;
+    };
+
+    // CLOCK over the slot array: a hit only sets the slot's reference bit (a relaxed store, so hits can share
+    // the lock), the hand clears bits until it finds an unreferenced slot.
+    class ClockEviction
+    {
+      public:
+        static constexpr bool kReadOnlyAccess = true;
+
+        void reserve(size_t slots)
+        {
+            slots_ = slots;
+            referenced_.reset(new std::atomic<uint8_t>[slots]);
+            occupied_.assign(slots, 0);
+            for (size_t i = 0; i < slots; ++i)
+            {
+                referenced_[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        void onInsert(SlotIndex slot)
+        {
+            occupied_[slot] = 1;
+            referenced_[slot].store(0, std::memory_order_relaxed);
+        }
+        void onAccess(SlotIndex slot) const { referenced_[slot].store(1, std::memory_order_relaxed); }
+        void onRemove(SlotIndex slot) { occupied_[slot] = 0; }
+
+        // only called on a full cache, so at most two sweeps
+        SlotIndex victim()
+        {
+            for (;;)
+            {
+                SlotIndex slot = static_cast<SlotIndex>(hand_);
+                hand_ = hand_ + 1 == slots_ ? 0 : hand_ + 1;
+                if (!occupied_[slot]) continue;
+                if (referenced_[slot].load(std::memory_order_relaxed))
+                {
+                    referenced_[slot].store(0, std::memory_order_relaxed);
+                    continue;
+                }
+                return slot;
+            }
+        }
+
+      private:
+        size_t slots_ = 0;
+        size_t hand_ = 0;
+        std::unique_ptr<std::atomic<uint8_t>[]> referenced_;
+        std::vector<uint8_t> occupied_;
+    };
+
+    // ---- configuration ----
+
+    // stands in for CacheStats when stats are off
+    struct DisabledStats
+    {
+        void record(CacheStats::Counter, uint64_t = 1) {}
+
+        struct Timer
+        {
+            explicit Timer(DisabledStats &) {}
+        };
+    };
+
+    // stands in for the timer wheel when expiry is off
+    struct DisabledExpiry
+    {
+    };
+
+    template <template <typename> class HashT = Hasher, typename LockT = std::mutex,
+              template <typename> class AllocatorT = std::allocator, typename EvictionT = LruEviction,
+              bool StatsOn = true, bool ExpiryOn = false>
+    struct CacheConfig
+    {
+        template <typename Key>
+        using Hash = HashT<Key>;
+        using Lock = LockT;
+        template <typename T>
+        using Allocator = AllocatorT<T>;
+        using Eviction = EvictionT;
+        static constexpr bool kStats = StatsOn;
+        static constexpr bool kExpiry = ExpiryOn;
+
+        template <template <typename> class H>
+        using WithHash = CacheConfig<H, LockT, AllocatorT, EvictionT, StatsOn, ExpiryOn>;
+        template <typename L>
+        using WithLock = CacheConfig<HashT, L, AllocatorT, EvictionT, StatsOn, ExpiryOn>;
+        template <template <typename> class A>
+        using WithAllocator = CacheConfig<HashT, LockT, A, EvictionT, StatsOn, ExpiryOn>;
+        template <typename E>
+        using WithEviction = CacheConfig<HashT, LockT, AllocatorT, E, StatsOn, ExpiryOn>;
+        template <bool S>
+        using WithStats = CacheConfig<HashT, LockT, AllocatorT, EvictionT, S, ExpiryOn>;
+        template <bool E>
+        using WithExpiry = CacheConfig<HashT, LockT, AllocatorT, EvictionT, StatsOn, E>;
+    };
+
+    // ---- the cache ----
+
+    // Capacity is an entry count. Nodes live in one allocation of capacity slots made up front with the
+    // configured allocator, so their addresses never move and a full cache recycles the victim's slot.
+    // Expired entries miss at once and are reclaimed by the next put.
+    template <typename Key, typename Value, typename Config = CacheConfig<>>
+    class BasicCache
+    {
+      public:
+        using KeyType = Key;
+        using ValueType = Value;
+        using Hash = typename Config::template Hash<Key>;
+        using Lock = typename Config::Lock;
+        using Eviction = typename Config::Eviction;
+        using Duration = TimerWheel::Duration;
+        static constexpr bool kStats = Config::kStats;
+        static constexpr bool kExpiry = Config::kExpiry;
+
+        explicit BasicCache(size_t capacity) : capacity_(capacity), size_(0), index_(capacity)
+        {
+            nodes_.resize(capacity);
+            freeSlots_.reserve(capacity);
+            for (size_t i = capacity; i > 0; --i)
+            {
+                freeSlots_.push_back(static_cast<SlotIndex>(i - 1));
+            }
+            eviction_.reserve(capacity);
+        }
+
+        BasicCache(const BasicCache &) = delete;
+        BasicCache &operator=(const BasicCache &) = delete;
+
+        bool get(const Key &key, Value &value) { return getWithHash(key, Hash{}(key), value); }
+
+        Value get(const Key &key)
+        {
+            Value value{};
+            get(key, value);
+            return value;
+        }
+
+        // hash must be Hash{}(key)
+        bool getWithHash(const Key &key, uint64_t hash, Value &value)
+        {
+            typename Stats::Timer timer(stats_);
+            bool hit = kSharedGets ? lookupShared(key, hash, value) : lookupExclusive(key, hash, value);
+            stats_.record(hit ? CacheStats::Counter::Hits : CacheStats::Counter::Misses);
+            return hit;
+        }
+
+        void put(const Key &key, const Value &value) { putWithHash(key, Hash{}(key), value); }
+
+        void putWithHash(const Key &key, uint64_t hash, const Value &value)
+        {
+            typename Stats::Timer timer(stats_);
+            std::lock_guard<Lock> lock(lock_);
+            putEntry(key, value, hash, 0);
+        }
+
+        void put(Key &&key, Value &&value)
+        {
+            uint64_t hash = Hash{}(key);
+            putWithHash(std::move(key), hash, std::move(value));
+        }
+
+        void putWithHash(Key &&key, uint64_t hash, Value &&value)
+        {
+            typename Stats::Timer timer(stats_);
+            std::lock_guard<Lock> lock(lock_);
+            putEntry(std::move(key), std::move(value), hash, 0);
+        }
+
+        // per-entry time to live, needs Expiry<true>
+        void put(const Key &key, const Value &value, Duration ttl)
+        {
+            static_assert(kExpiry, "put with a time to live needs an Expiry<true> cache");
+            uint64_t hash = Hash{}(key);
+            typename Stats::Timer timer(stats_);
+            std::lock_guard<Lock> lock(lock_);
+            putEntry(key, value, hash, ttl.count() > 0 ? static_cast<uint64_t>(ttl.count()) : 0);
+        }
+
+        // default time to live of every write, needs Expiry<true>
+        void setExpireAfterWrite(Duration ttl)
+        {
+            static_assert(kExpiry, "setExpireAfterWrite needs an Expiry<true> cache");
+            std::lock_guard<Lock> lock(lock_);
+            expireAfterWrite_ = ttl.count() > 0 ? static_cast<uint64_t>(ttl.count()) : 0;
+        }
+
+        bool remove(const Key &key)
+        {
+            uint64_t hash = Hash{}(key);
+            std::lock_guard<Lock> lock(lock_);
+            SlotIndex slot = findSlot(key, hash);
+            if (slot == kNullSlot) return false;
+            removeSlot(slot);
+            return true;
+        }
+
+        size_t size()
+        {
+            std::lock_guard<Lock> lock(lock_);
+            return size_;
+        }
+
+        size_t capacity() const { return capacity_; }
+
+        // needs Stats<true>
+        CacheStatsSnapshot stats()
+        {
+            static_assert(kStats, "stats() needs a Stats<true> cache");
+            CacheStatsSnapshot snapshot;
+            stats_.fill(snapshot);
+            return snapshot;
+        }
+
+        void setLatencySampling(uint32_t period)
+        {
+            static_assert(kStats, "setLatencySampling() needs a Stats<true> cache");
+            stats_.setLatencySampling(period);
+        }
+
+      private:
+        struct Node
+        {
+            Key key{};
+            Value value{};
+            uint64_t hash = 0;
+        };
+
+        using Stats = std::conditional_t<kStats, CacheStats, DisabledStats>;
+        using Expiry = std::conditional_t<kExpiry, TimerWheel, DisabledExpiry>;
+        using NodeAllocator = typename Config::template Allocator<Node>;
+        using SlotAllocator = typename Config::template Allocator<SlotIndex>;
+
+        static constexpr bool kSharedGets = Eviction::kReadOnlyAccess && HasSharedLock<Lock>::value;
+
+        SlotIndex findSlot(const Key &key, uint64_t hash) const
+        {
+            return index_.find(hash, [&](SlotIndex slot) { return nodes_[slot].key == key; });
+        }
+
+        bool live(SlotIndex slot) const
+        {
+            if constexpr (kExpiry)
+            {
+                return slot != kNullSlot && !expiry_.expired(slot, TimerWheel::now());
+            }
+            else
+            {
+                return slot != kNullSlot;
+            }
+        }
+
+        bool lookupExclusive(const Key &key, uint64_t hash, Value &value)
+        {
+            std::lock_guard<Lock> lock(lock_);
+            SlotIndex slot = findSlot(key, hash);
+            if (!live(slot)) return false;
+            eviction_.onAccess(slot);
+            value = nodes_[slot].value;
+            return true;
+        }
+
+        bool lookupShared(const Key &key, uint64_t hash, Value &value)
+        {
+            if constexpr (kSharedGets)
+            {
+                std::shared_lock<Lock> lock(lock_);
+                SlotIndex slot = findSlot(key, hash);
+                if (!live(slot)) return false;
+                eviction_.onAccess(slot);
+                value = nodes_[slot].value;
+                return true;
+            }
+            else
+            {
+                return lookupExclusive(key, hash, value);
+            }
+        }
+
+        // caller holds the lock; ttl 0 picks the default
+        template <typename K, typename V>
+        void putEntry(K &&key, V &&value, uint64_t hash, uint64_t ttl)
+        {
+            if (capacity_ == 0) return;
+            stats_.record(CacheStats::Counter::Puts);
+            uint64_t now = 0;
+            if constexpr (kExpiry)
+            {
+                now = TimerWheel::now();
+                size_t expired = 0;
+                expiry_.advance(now, [this, &expired](SlotIndex slot) {
+                    removeSlot(slot);
+                    ++expired;
+                });
+                if (expired) stats_.record(CacheStats::Counter::Expirations, expired);
+            }
+            SlotIndex slot = findSlot(key, hash);
+            if (slot != kNullSlot)
+            {
+                nodes_[slot].value = std::forward<V>(value);
+                eviction_.onAccess(slot);
+            }
+            else
+            {
+                if (size_ == capacity_)
+                {
+                    removeSlot(eviction_.victim());
+                    stats_.record(CacheStats::Counter::Evictions);
+                }
+                slot = freeSlots_.back();
+                freeSlots_.pop_back();
+                Node &node = nodes_[slot];
+                node.key = std::forward<K>(key);
+                node.value = std::forward<V>(value);
+                node.hash = hash;
+                index_.insert(hash, slot);
+                eviction_.onInsert(slot);
+                ++size_;
+            }
+            if constexpr (kExpiry)
+            {
+                if (ttl == 0) ttl = expireAfterWrite_;
+                expiry_.schedule(slot, ttl ? now + ttl : 0);
+            }
+            (void)now;
+            (void)ttl;
+        }
+
+        void removeSlot(SlotIndex slot)
+        {
+            Node &node = nodes_[slot];
+            index_.erase(node.hash, slot);
+            eviction_.onRemove(slot);
+            if constexpr (kExpiry) expiry_.deschedule(slot);
+            node.key = Key();
+            node.value = Value();
+            freeSlots_.push_back(slot);
+            --size_;
+        }
+
+        size_t capacity_;
+        size_t size_;
+        Lock lock_;
+        FlatIndex<Key, Hash> index_;
+        std::vector<Node, NodeAllocator> nodes_;
+        std::vector<SlotIndex, SlotAllocator> freeSlots_;
+        Eviction eviction_;
+        Stats stats_;
+        Expiry expiry_;
+        uint64_t expireAfterWrite_ = 0;
+    };
+
+    // ICachePolicy over a BasicCache, for code that holds caches through the virtual interface. final, so
+    // calls through the adapter type itself are still devirtualized.
+    template <typename Cache>
+    class PolicyAdapter final : public ICachePolicy<typename Cache::KeyType, typename Cache::ValueType>
+    {
+      public:
+        using Key = typename Cache::KeyType;
+        using Value = typename Cache::ValueType;
+
+        template <typename... Args>
+        explicit PolicyAdapter(Args &&...args) : cache_(std::forward<Args>(args)...)
+        {
+        }
+
+        void put(const Key &key, const Value &value) override { cache_.put(key, value); }
+        void put(Key &&key, Value &&value) override { cache_.put(std::move(key), std::move(value)); }
+        bool get(const Key &key, Value &value) override { return cache_.get(key, value); }
+        Value get(const Key &key) override { return cache_.get(key); }
+        size_t weightedSize() override { return cache_.size(); }
+
+        // the interface's hash is Hasher<Key>, reused only when the cache hashes the same way
+        bool getWithHash(const Key &key, uint64_t hash, Value &value) override
+        {
+            if constexpr (kSameHash) return cache_.getWithHash(key, hash, value);
+            (void)hash;
+            return cache_.get(key, value);
+        }
+
+        void putWithHash(const Key &key, uint64_t hash, const Value &value) override
+        {
+            if constexpr (kSameHash)
+            {
+                cache_.putWithHash(key, hash, value);
+                return;
+            }
+            (void)hash;
+            cache_.put(key, value);
+        }
+
+        void putWithHash(Key &&key, uint64_t hash, Value &&value) override
+        {
+            if constexpr (kSameHash)
+            {
+                cache_.putWithHash(std::move(key), hash, std::move(value));
+                return;
+            }
+            (void)hash;
+            cache_.put(std::move(key), std::move(value));
+        }
+
+        Cache &cache() { return cache_; }
+
+      private:
+        static constexpr bool kSameHash = std::is_same<typename Cache::Hash, Hasher<Key>>::value;
+
+        Cache cache_;
+    };
+
+    // Type-level builder: each member alias returns a builder with one more choice made, Cache is the result
+    // and Policy the same cache behind ICachePolicy. Defaults: Hasher, std::mutex, std::allocator, LRU, stats
+    // on, expiry off.
+    template <typename Key, typename Value, typename Config = CacheConfig<>>
+    struct CacheBuilder
+    {
+        template <template <typename> class H>
+        using Hash = CacheBuilder<Key, Value, typename Config::template WithHash<H>>;
+        template <typename L>
+        using Lock = CacheBuilder<Key, Value, typename Config::template WithLock<L>>;
+        template <template <typename> class A>
+        using Allocator = CacheBuilder<Key, Value, typename Config::template WithAllocator<A>>;
+        template <typename E>
+        using Eviction = CacheBuilder<Key, Value, typename Config::template WithEviction<E>>;
+        template <bool On>
+        using Stats = CacheBuilder<Key, Value, typename Config::template WithStats<On>>;
+        template <bool On>
+        using Expiry = CacheBuilder<Key, Value, typename Config::template WithExpiry<On>>;
+
+        using Cache = BasicCache<Key, Value, Config>;
+        using Policy = PolicyAdapter<Cache>;
+    };
+}  // namespace MeltiCache
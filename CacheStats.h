@@ -0,0 +1,297 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace MeltiCache
+{
+    // Point-in-time copy of a cache's statistics, plain values that can be scraped, logged or summed over shards.
+    // Counters are cumulative since construction. Fields a policy does not have stay 0 (only ArcCache has two
+    // lists, ghost lists and a partition).
+    struct CacheStatsSnapshot
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t puts = 0;
+        uint64_t evictions = 0;     // all lists, capacity evictions only
+        uint64_t lruEvictions = 0;  // ArcCache: evictions from the LRU part
+        uint64_t lfuEvictions = 0;  // ArcCache: evictions from the LFU part
+        uint64_t lruGhostHits = 0;  // ArcCache: puts that hit the LRU ghost list and grew the LRU part
+        uint64_t lfuGhostHits = 0;  // ArcCache: puts that hit the LFU ghost list and grew the LFU part
+        uint64_t expirations = 0;   // entries dropped because their time to live ran out
+        // ArcCache partition, in weight units: the budgets ghost hits have shifted and the weight held by each part
+        uint64_t lruCapacity = 0;
+        uint64_t lfuCapacity = 0;
+        uint64_t lruWeight = 0;
+        uint64_t lfuWeight = 0;
+        // sampled operation latencies, see LatencyHistogram; empty while sampling is off
+        std::vector<uint64_t> latencyCounts;
+
+        double hitRatio() const
+        {
+            uint64_t lookups = hits + misses;
+            return lookups ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+        }
+
+        uint64_t latencySamples() const
+        {
+            uint64_t total = 0;
+            for (uint64_t count : latencyCounts)
+            {
+                total += count;
+            }
+            return total;
+        }
+
+        // upper bound, in nanoseconds, of the bucket holding the p-quantile (p in [0, 1]) of the sampled latencies
+        uint64_t latencyPercentile(double p) const;
+
+        CacheStatsSnapshot &operator+=(const CacheStatsSnapshot &other)
+        {
+            hits += other.hits;
+            misses += other.misses;
+            puts += other.puts;
+            evictions += other.evictions;
+            lruEvictions += other.lruEvictions;
+            lfuEvictions += other.lfuEvictions;
+            lruGhostHits += other.lruGhostHits;
+            lfuGhostHits += other.lfuGhostHits;
+            expirations += other.expirations;
+            lruCapacity += other.lruCapacity;
+            lfuCapacity += other.lfuCapacity;
+            lruWeight += other.lruWeight;
+            lfuWeight += other.lfuWeight;
+            if (latencyCounts.size() < other.latencyCounts.size()) latencyCounts.resize(other.latencyCounts.size());
+            for (size_t i = 0; i < other.latencyCounts.size(); ++i)
+            {
+                latencyCounts[i] += other.latencyCounts[i];
+            }
+            return *this;
+        }
+    };
+
+    // HDR-style histogram of nanosecond latencies: 16 linear sub-buckets per power of two, so any recorded value
+    // is off by at most 1/16 (6.25%) of itself, from 1 ns up to 2^40 ns (about 18 minutes; longer is clamped).
+    class LatencyHistogram
+    {
+      public:
+        static constexpr unsigned kSubBits = 4;
+        static constexpr unsigned kMaxExponent = 40;
+        static constexpr size_t kBuckets = (kMaxExponent - kSubBits + 2) << kSubBits;
+
+        LatencyHistogram()
+        {
+            for (auto &count : counts_)
+            {
+                count.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        void record(uint64_t nanos) { counts_[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed); }
+
+        void copyTo(std::vector<uint64_t> &counts) const
+        {
+            counts.resize(kBuckets);
+            for (size_t i = 0; i < kBuckets; ++i)
+            {
+                counts[i] = counts_[i].load(std::memory_order_relaxed);
+            }
+        }
+
+        static size_t bucketOf(uint64_t nanos)
+        {
+            constexpr uint64_t kSub = uint64_t(1) << kSubBits;
+            if (nanos < kSub) return static_cast<size_t>(nanos);
+            unsigned exponent = 63 - static_cast<unsigned>(countLeadingZeros(nanos));
+            if (exponent > kMaxExponent) return kBuckets - 1;
+            uint64_t sub = (nanos >> (exponent - kSubBits)) & (kSub - 1);
+            return static_cast<size_t>(((exponent - kSubBits + 1) << kSubBits) + sub);
+        }
+
+        // largest value that falls into the bucket
+        static uint64_t upperBoundOf(size_t bucket)
+        {
+            constexpr uint64_t kSub = uint64_t(1) << kSubBits;
+            if (bucket < kSub) return bucket;
+            unsigned exponent = static_cast<unsigned>(bucket >> kSubBits) + kSubBits - 1;
+            uint64_t sub = bucket & (kSub - 1);
+            return ((kSub + sub + 1) << (exponent - kSubBits)) - 1;
+        }
+
+      private:
+        static unsigned countLeadingZeros(uint64_t value)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return static_cast<unsigned>(__builtin_clzll(value));
+#else
+            unsigned n = 0;
+            for (uint64_t bit = uint64_t(1) << 63; !(value & bit); bit >>= 1)
+            {
+                ++n;
+            }
+            return n;
+#endif
+        }
+
+        std::atomic<uint64_t> counts_[kBuckets];
+    };
+
+    inline uint64_t CacheStatsSnapshot::latencyPercentile(double p) const
+    {
+        uint64_t total = latencySamples();
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < latencyCounts.size(); ++i)
+        {
+            seen += latencyCounts[i];
+            if (seen >= rank) return LatencyHistogram::upperBoundOf(i);
+        }
+        return LatencyHistogram::upperBoundOf(latencyCounts.size() - 1);
+    }
+
+    // Counters a policy bumps on its hot paths. Each thread adds to its own cache-line-sized stripe with a
+    // relaxed add, so readers under a shared lock never contend on a counter line; fill() sums the stripes.
+    // Latency is sampled: with a period of N every N-th operation of a thread is timed (two clock reads) and
+    // recorded in a histogram, the others cost one relaxed load.
+    // Compiled with MELTICACHE_NO_STATS every member is an empty inline function and the object holds no data.
+    class CacheStats
+    {
+      public:
+        enum class Counter : uint8_t
+        {
+            Hits,
+            Misses,
+            Puts,
+            Evictions,
+            LruGhostHits,
+            LfuGhostHits,
+            Expirations,
+            Count
+        };
+
+#ifndef MELTICACHE_NO_STATS
+        CacheStats() : samplePeriod_(0)
+        {
+            for (Stripe &stripe : stripes_)
+            {
+                for (auto &count : stripe.counts)
+                {
+                    count.store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        CacheStats(const CacheStats &) = delete;
+        CacheStats &operator=(const CacheStats &) = delete;
+
+        void record(Counter counter, uint64_t n = 1)
+        {
+            stripes_[stripeIndex()].counts[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+        }
+
+        // times every period-th operation of each thread (rounded up to a power of two), 0 stops sampling;
+        // not meant to race with itself, but safe against concurrent operations
+        void setLatencySampling(uint32_t period)
+        {
+            uint32_t rounded = 1;
+            while (rounded < period)
+            {
+                rounded <<= 1;
+            }
+            if (period && !histogram_) histogram_ = std::make_unique<LatencyHistogram>();
+            samplePeriod_.store(period ? rounded : 0, std::memory_order_release);
+        }
+
+        // fills the counters and latency histogram of the snapshot, policies add their own partition fields
+        void fill(CacheStatsSnapshot &snapshot) const
+        {
+            uint64_t totals[static_cast<size_t>(Counter::Count)] = {};
+            for (const Stripe &stripe : stripes_)
+            {
+                for (size_t i = 0; i < static_cast<size_t>(Counter::Count); ++i)
+                {
+                    totals[i] += stripe.counts[i].load(std::memory_order_relaxed);
+                }
+            }
+            snapshot.hits = totals[static_cast<size_t>(Counter::Hits)];
+            snapshot.misses = totals[static_cast<size_t>(Counter::Misses)];
+            snapshot.puts = totals[static_cast<size_t>(Counter::Puts)];
+            snapshot.evictions = totals[static_cast<size_t>(Counter::Evictions)];
+            snapshot.lruGhostHits = totals[static_cast<size_t>(Counter::LruGhostHits)];
+            snapshot.lfuGhostHits = totals[static_cast<size_t>(Counter::LfuGhostHits)];
+            snapshot.expirations = totals[static_cast<size_t>(Counter::Expirations)];
+            if (samplePeriod_.load(std::memory_order_acquire)) histogram_->copyTo(snapshot.latencyCounts);
+        }
+
+        // Times the enclosing scope when this operation is sampled.
+        class Timer
+        {
+          public:
+            explicit Timer(CacheStats &stats) : histogram_(nullptr)
+            {
+                uint32_t period = stats.samplePeriod_.load(std::memory_order_acquire);
+                if (period && (++tick() & (period - 1)) == 0)
+                {
+                    histogram_ = stats.histogram_.get();
+                    start_ = std::chrono::steady_clock::now();
+                }
+            }
+
+            ~Timer()
+            {
+                if (!histogram_) return;
+                auto elapsed = std::chrono::steady_clock::now() - start_;
+                histogram_->record(
+                    static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            }
+
+            Timer(const Timer &) = delete;
+            Timer &operator=(const Timer &) = delete;
+
+          private:
+            static uint32_t &tick()
+            {
+                static thread_local uint32_t ticks = 0;
+                return ticks;
+            }
+
+            LatencyHistogram *histogram_;
+            std::chrono::steady_clock::time_point start_;
+        };
+
+      private:
+        static constexpr size_t kStripes = 16;
+
+        struct alignas(64) Stripe
+        {
+            std::atomic<uint64_t> counts[static_cast<size_t>(Counter::Count)];
+        };
+
+        static size_t stripeIndex()
+        {
+            static thread_local size_t index = std::hash<std::thread::id>{}(std::this_thread::get_id()) * 0x9e3779b9u;
+            return (index >> 16) & (kStripes - 1);
+        }
+
+        Stripe stripes_[kStripes];
+        std::atomic<uint32_t> samplePeriod_;
+        std::unique_ptr<LatencyHistogram> histogram_;  // allocated on first setLatencySampling, never freed early
+#else
+        void record(Counter, uint64_t = 1) {}
+        void setLatencySampling(uint32_t) {}
+        void fill(CacheStatsSnapshot &) const {}
+
+        class Timer
+        {
+          public:
+            explicit Timer(CacheStats &) {}
+        };
+#endif
+    };
+}  // namespace MeltiCache
@@ -0,0 +1,463 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include "FlatIndex.h"
+#include "ICachePolicy.h"
+#include "NodePool.h"
+
+// CLOCK: entries sit in a fixed slot array, a hit only sets the slot's reference bit (relaxed atomic) under
+// the shared lock, and the eviction hand sweeps the array clearing bits until it finds an unreferenced slot.
+// Readers never write list pointers, so it is a drop-in, low-contention alternative to LruCache.
+template <typename Key, typename Value>
+class ClockCache : public MeltiCache::ICachePolicy<Key, Value>
+{
+  public:
+    ClockCache(int capacity)
+        : capacity_(capacity > 0 ? capacity : 0),
+          used_(0),
+          hand_(0),
+          keys_(capacity_),
+          hashes_(capacity_),
+          values_(capacity_),
+          refBits_(new std::atomic<uint8_t>[capacity_ ? capacity_ : 1])
+    {
+        for (size_t i = 0; i < capacity_; ++i)
+        {
+            refBits_[i].store(0, std::memory_order_relaxed);
+        }
+        map_.reserve(capacity_);
+    }
+
+    void put(const Key& key, const Value& value) override { ClockCache::putWithHash(key, map_.hash(key), value); }
+
+    void putWithHash(const Key& key, uint64_t hash, const Value& value) override
+    {
+        if (capacity_ == 0) return;
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        putImpl(key, value, hash);
+    }
+
+    void put(Key&& key, Value&& value) override
+    {
+        uint64_t hash = map_.hash(key);
+        ClockCache::putWithHash(std::move(key), hash, std::move(value));
+    }
+
+    void putWithHash(Key&& key, uint64_t hash, Value&& value) override
+    {
+        if (capacity_ == 0) return;
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        putImpl(std::move(key), std::move(value), hash);
+    }
+
+    bool insertIfAbsent(const Key& key, const std::function<Value()>& makeValue) override
+    {
+        return ClockCache::insertIfAbsentWithHash(key, map_.hash(key), makeValue);
+    }
+
+    bool insertIfAbsentWithHash(const Key& key, uint64_t hash, const std::function<Value()>& makeValue) override
+    {
+        if (capacity_ == 0) return false;
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (findSlot(key, hash) != MeltiCache::kNullSlot) return false;
+        insertNew(key, makeValue(), hash);
+        return true;
+    }
+
+    bool get(const Key& key, Value& value) override { return ClockCache::getWithHash(key, map_.hash(key), value); }
+
+    bool getWithHash(const Key& key, uint64_t hash, Value& value) override
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        MeltiCache::SlotIndex slot = findSlot(key, hash);
+        if (slot == MeltiCache::kNullSlot) return false;
+        value = values_[slot];
+        std::atomic<uint8_t>& ref = refBits_[slot];
+        if (!ref.load(std::memory_order_relaxed))
+        {
+            ref.store(1, std::memory_order_relaxed);  // only write the cache line when the bit changes
+        }
+        return true;
+    }
+
+    Value get(const Key& key) override
+    {
+        Value value{};
+        get(key, value);
+        return value;
+    }
+
+    // CLOCK has no weigher, every entry weighs 1
+    size_t weightedSize() override
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return map_.size();
+    }
+
+  private:
+    MeltiCache::SlotIndex findSlot(const Key& key, uint64_t hash) const
+    {
+        return map_.find(hash, [&](MeltiCache::SlotIndex slot) { return keys_[slot] == key; });
+    }
+
+    template <typename K, typename V>
+    void putImpl(K&& key, V&& value, uint64_t hash)
+    {
+        MeltiCache::SlotIndex slot = findSlot(key, hash);
+        if (slot != MeltiCache::kNullSlot)
+        {
+            values_[slot] = std::forward<V>(value);
+            refBits_[slot].store(1, std::memory_order_relaxed);
+            return;
+        }
+        insertNew(std::forward<K>(key), std::forward<V>(value), hash);
+    }
+
+    template <typename K, typename V>
+    void insertNew(K&& key, V&& value, uint64_t hash)
+    {
+        size_t slot = used_ < capacity_ ? used_++ : evict();
+        map_.insert(hash, static_cast<MeltiCache::SlotIndex>(slot));
+        keys_[slot] = std::forward<K>(key);
+        hashes_[slot] = hash;
+        values_[slot] = std::forward<V>(value);
+        // new entries start unreferenced: a key touched only once is the first to go on the next sweep
+        refBits_[slot].store(0, std::memory_order_relaxed);
+    }
+
+    // sweep from the hand, giving referenced slots a second chance; returns the freed slot
+    size_t evict()
+    {
+        while (refBits_[hand_].load(std::memory_order_relaxed))
+        {
+            refBits_[hand_].store(0, std::memory_order_relaxed);
+            hand_ = hand_ + 1 == capacity_ ? 0 : hand_ + 1;
+        }
+        size_t victim = hand_;
+        hand_ = hand_ + 1 == capacity_ ? 0 : hand_ + 1;
+        map_.erase(hashes_[victim], static_cast<MeltiCache::SlotIndex>(victim));
+        return victim;
+    }
+
+  private:
+    size_t capacity_;
+    size_t used_;  // slots [0, used_) are occupied
+    size_t hand_;
+    std::vector<Key> keys_;
+    std::vector<uint64_t> hashes_;  // Hasher<Key> hash of each slot's key, so the hand never rehashes
+    std::vector<Value> values_;
+    std::unique_ptr<std::atomic<uint8_t>[]> refBits_;
+    MeltiCache::FlatIndex<Key> map_;
+    std::shared_mutex mutex_;
+};
+
+// CLOCK-Pro (Jiang, Chen, Zhang, USENIX ATC 2005): one clock holds hot and cold resident pages plus
+// non-resident "test" pages that remember recently evicted cold keys. A miss on a test page means the key
+// came back within its test period, so it is admitted as hot and the cold target shrinks; test pages that
+// expire grow the cold target again. This keeps one-off scans from flushing the hot set.
+// Hits are the same as ClockCache: shared lock plus a relaxed reference bit.
+template <typename Key, typename Value>
+class ClockProCache : public MeltiCache::ICachePolicy<Key, Value>
+{
+  private:
+    enum class PageType : uint8_t
+    {
+        Hot,
+        Cold,
+        Test
+    };
+
+    struct Node
+    {
+        Key key_;
+        Value value_;
+        PageType type_ = PageType::Cold;
+        uint64_t hash_ = 0;
+        std::atomic<bool> ref_{false};
+        MeltiCache::SlotIndex prev_ = MeltiCache::kNullSlot;
+        MeltiCache::SlotIndex next_ = MeltiCache::kNullSlot;
+    };
+
+    using NodePool = MeltiCache::NodePool<Node>;
+    using Slot = MeltiCache::SlotIndex;
+
+  public:
+    ClockProCache(int capacity)
+        : memMax_(capacity > 0 ? capacity : 0),
+          memCold_(memMax_),
+          countHot_(0),
+          countCold_(0),
+          countTest_(0),
+          handHot_(MeltiCache::kNullSlot),
+          handCold_(MeltiCache::kNullSlot),
+          handTest_(MeltiCache::kNullSlot),
+          pool_(2 * memMax_ + 1)
+    {
+        map_.reserve(2 * memMax_);
+    }
+
+    void put(const Key& key, const Value& value) override
+    {
+        ClockProCache::putWithHash(key, map_.hash(key), value);
+    }
+
+    void putWithHash(const Key& key, uint64_t hash, const Value& value) override
+    {
+        if (memMax_ == 0) return;
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        putImpl(key, value, hash);
+    }
+
+    void put(Key&& key, Value&& value) override
+    {
+        uint64_t hash = map_.hash(key);
+        ClockProCache::putWithHash(std::move(key), hash, std::move(value));
+    }
+
+    void putWithHash(Key&& key, uint64_t hash, Value&& value) override
+    {
+        if (memMax_ == 0) return;
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        putImpl(std::move(key), std::move(value), hash);
+    }
+
+    // test pages count as absent, inserting one brings the key back as hot like a put
+    bool insertIfAbsent(const Key& key, const std::function<Value()>& makeValue) override
+    {
+        return ClockProCache::insertIfAbsentWithHash(key, map_.hash(key), makeValue);
+    }
+
+    bool insertIfAbsentWithHash(const Key& key, uint64_t hash, const std::function<Value()>& makeValue) override
+    {
+        if (memMax_ == 0) return false;
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        Slot slot = findSlot(key, hash);
+        if (slot != MeltiCache::kNullSlot && pool_[slot].type_ != PageType::Test) return false;
+        putImpl(key, makeValue(), hash);
+        return true;
+    }
+
+    bool get(const Key& key, Value& value) override
+    {
+        return ClockProCache::getWithHash(key, map_.hash(key), value);
+    }
+
+    bool getWithHash(const Key& key, uint64_t hash, Value& value) override
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        Slot slot = findSlot(key, hash);
+        if (slot == MeltiCache::kNullSlot) return false;
+        Node& node = pool_[slot];
+        if (node.type_ == PageType::Test) return false;  // non-resident, only metadata is kept
+        value = node.value_;
+        if (!node.ref_.load(std::memory_order_relaxed))
+        {
+            node.ref_.store(true, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    Value get(const Key& key) override
+    {
+        Value value{};
+        get(key, value);
+        return value;
+    }
+
+    // resident pages only, test pages hold no value
+    size_t weightedSize() override
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return countHot_ + countCold_;
+    }
+
+  private:
+    Slot findSlot(const Key& key, uint64_t hash) const
+    {
+        return map_.find(hash, [&](Slot slot) { return pool_[slot].key_ == key; });
+    }
+
+    template <typename K, typename V>
+    void putImpl(K&& key, V&& value, uint64_t hash)
+    {
+        Slot slot = findSlot(key, hash);
+        if (slot == MeltiCache::kNullSlot)
+        {
+            slot = pool_.allocate();
+            Node& node = pool_[slot];
+            node.key_ = std::forward<K>(key);
+            node.hash_ = hash;
+            node.value_ = std::forward<V>(value);
+            node.type_ = PageType::Cold;
+            node.ref_.store(false, std::memory_order_relaxed);
+            addToClock(slot);
+            ++countCold_;
+            return;
+        }
+
+        Node& node = pool_[slot];
+        if (node.type_ != PageType::Test)
+        {
+            node.value_ = std::forward<V>(value);
+            node.ref_.store(true, std::memory_order_relaxed);
+            return;
+        }
+
+        // re-access within the test period: give cold pages more room and bring the key back as hot
+        if (memCold_ < memMax_) ++memCold_;
+        node.ref_.store(false, std::memory_order_relaxed);
+        node.value_ = std::forward<V>(value);
+        node.type_ = PageType::Hot;
+        --countTest_;
+        removeFromClock(slot);
+        addToClock(slot);
+        ++countHot_;
+    }
+
+    // makes room, then links the node just behind the hot hand (the newest position of the clock)
+    void addToClock(Slot slot)
+    {
+        evict();
+        map_.insert(pool_[slot].hash_, slot);
+        Node& node = pool_[slot];
+        if (handHot_ == MeltiCache::kNullSlot)
+        {
+            node.prev_ = slot;
+            node.next_ = slot;
+            handHot_ = handCold_ = handTest_ = slot;
+            return;
+        }
+        Slot prev = pool_[handHot_].prev_;
+        node.prev_ = prev;
+        node.next_ = handHot_;
+        pool_[prev].next_ = slot;
+        pool_[handHot_].prev_ = slot;
+        if (handCold_ == handHot_)
+        {
+            handCold_ = pool_[handCold_].prev_;
+        }
+    }
+
+    // unlinks the node and drops it from the map, hands pointing at it step back one position
+    void removeFromClock(Slot slot)
+    {
+        Node& node = pool_[slot];
+        map_.erase(node.hash_, slot);
+        if (node.next_ == slot)
+        {
+            handHot_ = handCold_ = handTest_ = MeltiCache::kNullSlot;
+        }
+        else
+        {
+            if (handHot_ == slot) handHot_ = node.prev_;
+            if (handCold_ == slot) handCold_ = node.prev_;
+            if (handTest_ == slot) handTest_ = node.prev_;
+            pool_[node.prev_].next_ = node.next_;
+            pool_[node.next_].prev_ = node.prev_;
+        }
+        node.prev_ = node.next_ = MeltiCache::kNullSlot;
+    }
+
+    void evict()
+    {
+        while (memMax_ <= countHot_ + countCold_)
+        {
+            runHandCold();
+        }
+    }
+
+    void runHandCold()
+    {
+        Node& node = pool_[handCold_];
+        if (node.type_ == PageType::Cold)
+        {
+            if (node.ref_.load(std::memory_order_relaxed))
+            {
+                // referenced during its test period: promote
+                node.type_ = PageType::Hot;
+                node.ref_.store(false, std::memory_order_relaxed);
+                --countCold_;
+                ++countHot_;
+            }
+            else
+            {
+                // evict the value but keep the key as a test page
+                node.type_ = PageType::Test;
+                node.value_ = Value();
+                --countCold_;
+                ++countTest_;
+                while (memMax_ < countTest_)
+                {
+                    runHandTest();
+                }
+            }
+        }
+        handCold_ = pool_[handCold_].next_;
+        while (memMax_ - memCold_ < countHot_)
+        {
+            runHandHot();
+        }
+    }
+
+    void runHandHot()
+    {
+        if (handHot_ == handTest_)
+        {
+            runHandTest();
+        }
+        Node& node = pool_[handHot_];
+        if (node.type_ == PageType::Hot)
+        {
+            if (node.ref_.load(std::memory_order_relaxed))
+            {
+                node.ref_.store(false, std::memory_order_relaxed);
+            }
+            else
+            {
+                node.type_ = PageType::Cold;
+                --countHot_;
+                ++countCold_;
+            }
+        }
+        handHot_ = pool_[handHot_].next_;
+    }
+
+    // unlike the paper the test hand simply passes the cold hand instead of pushing it along; the paper's
+    // mutual hand pushing can recurse without progress on very small clocks
+    void runHandTest()
+    {
+        if (pool_[handTest_].type_ == PageType::Test)
+        {
+            // test period over without a re-access: forget the key and give hot pages more room
+            Slot slot = handTest_;
+            Slot prev = pool_[slot].prev_;
+            removeFromClock(slot);
+            pool_.release(slot);
+            --countTest_;
+            if (memCold_ > 1) --memCold_;
+            if (handTest_ == MeltiCache::kNullSlot) return;
+            handTest_ = prev;
+        }
+        handTest_ = pool_[handTest_].next_;
+    }
+
+  private:
+    size_t memMax_;     // resident capacity
+    size_t memCold_;    // target number of resident cold pages, adapted by test page hits and expiries
+    size_t countHot_;
+    size_t countCold_;
+    size_t countTest_;  // non-resident pages, bounded by memMax_
+    Slot handHot_;
+    Slot handCold_;
+    Slot handTest_;
+    NodePool pool_;
+    MeltiCache::FlatIndex<Key> map_;
+    std::shared_mutex mutex_;
+};
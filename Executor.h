@@ -0,0 +1,85 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace MeltiCache
+{
+    // Small fixed pool of worker threads for background cache work: refresh-ahead reloads and the loads behind
+    // the coroutine gets. Tasks run in submission order per worker; a task that throws is dropped, tasks
+    // report their own failures. The destructor runs whatever is still queued, then joins the workers.
+    class Executor
+    {
+      public:
+        explicit Executor(size_t threads = 1) : stopping_(false)
+        {
+            if (threads == 0) threads = 1;
+            workers_.reserve(threads);
+            for (size_t i = 0; i < threads; ++i)
+            {
+                workers_.emplace_back([this]() { work(); });
+            }
+        }
+
+        ~Executor()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            ready_.notify_all();
+            for (std::thread &worker : workers_)
+            {
+                worker.join();
+            }
+        }
+
+        Executor(const Executor &) = delete;
+        Executor &operator=(const Executor &) = delete;
+
+        void submit(std::function<void()> task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                tasks_.push_back(std::move(task));
+            }
+            ready_.notify_one();
+        }
+
+        size_t threadCount() const { return workers_.size(); }
+
+      private:
+        void work()
+        {
+            for (;;)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    ready_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+                    if (tasks_.empty()) return;
+                    task = std::move(tasks_.front());
+                    tasks_.pop_front();
+                }
+                try
+                {
+                    task();
+                }
+                catch (...)
+                {
+                }
+            }
+        }
+
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::deque<std::function<void()>> tasks_;
+        bool stopping_;
+        std::vector<std::thread> workers_;
+    };
+}  // namespace MeltiCache
@@ -0,0 +1,211 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Hasher.h"
+#include "NodePool.h"
+
+namespace MeltiCache
+{
+    // Open-addressed key -> slot index shared by the pooled policies, in place of std::unordered_map<Key, Slot>.
+    // Swiss-table layout: one control byte per bucket (empty, or 7 bits of the hash) scanned 16 at a time with
+    // SSE2, next to an 8-byte entry holding the pool slot and the hash bits that pick the home bucket.
+    // The index stores no keys: find() takes an equality predicate that compares against the node in the pool,
+    // so a hit costs the control group, the entry and the node the policy reads anyway.
+    // Probing is linear, which lets erase() shift the rest of the cluster back instead of leaving tombstones,
+    // so a cache that evicts on every insert never degrades or needs a cleanup rehash. Growth moves control
+    // bytes and entries only, keys are never rehashed.
+    // Not thread safe; find() is const and may run concurrently with other finds.
+    template <typename Key, typename Hash = Hasher<Key>>
+    class FlatIndex
+    {
+      public:
+        explicit FlatIndex(size_t expected = 0) : size_(0) { rehash(bucketsFor(expected)); }
+
+        // the low 7 bits are the control tag and the next ones pick the home bucket, so Hash must mix all bits
+        uint64_t hash(const Key &key) const { return hasher_(key); }
+
+        // slot whose node satisfies equal(slot), kNullSlot if none
+        template <typename Equal>
+        SlotIndex find(uint64_t hash, Equal &&equal) const
+        {
+            int8_t tag = tagOf(hash);
+            for (size_t pos = homeOf(hash) & mask_;; pos = (pos + kGroup) & mask_)
+            {
+                for (uint32_t hits = match(pos, tag); hits; hits &= hits - 1)
+                {
+                    const Entry &entry = entries_[(pos + lowestBit(hits)) & mask_];
+                    if (equal(entry.slot)) return entry.slot;
+                }
+                if (match(pos, kEmpty)) return kNullSlot;
+            }
+        }
+
+        // the key must not be indexed yet
+        void insert(uint64_t hash, SlotIndex slot)
+        {
+            if ((size_ + 1) * 4 > (mask_ + 1) * 3)
+            {
+                rehash(2 * (mask_ + 1));
+            }
+            place(tagOf(hash), Entry{slot, homeOf(hash)});
+            ++size_;
+        }
+
+        // removes the entry of this exact slot, found through the slot's hash without comparing keys
+        void erase(uint64_t hash, SlotIndex slot)
+        {
+            size_t hole = locate(hash, slot);
+            if (hole == kNotFound) return;
+            --size_;
+            // backward shift: pull later members of the cluster into the hole unless their home lies
+            // cyclically in (hole, i], in which case moving them would put them before their home
+            for (size_t i = (hole + 1) & mask_; ctrl_[i] != kEmpty; i = (i + 1) & mask_)
+            {
+                size_t home = entries_[i].home & mask_;
+                bool stays = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+                if (!stays)
+                {
+                    setCtrl(hole, ctrl_[i]);
+                    entries_[hole] = entries_[i];
+                    hole = i;
+                }
+            }
+            setCtrl(hole, kEmpty);
+        }
+
+        // repoints the key's entry at another slot, e.g. when a pinned node is replaced by a fresh copy
+        void replace(uint64_t hash, SlotIndex from, SlotIndex to)
+        {
+            size_t at = locate(hash, from);
+            if (at != kNotFound) entries_[at].slot = to;
+        }
+
+        void reserve(size_t expected)
+        {
+            size_t buckets = bucketsFor(expected);
+            if (buckets > mask_ + 1) rehash(buckets);
+        }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+      private:
+        struct Entry
+        {
+            SlotIndex slot;
+            uint32_t home;  // hash bits above the tag, the home bucket is home & mask_
+        };
+
+        static constexpr size_t kGroup = 16;
+        static constexpr int8_t kEmpty = -128;  // full buckets hold a tag in 0..127
+        static constexpr size_t kNotFound = SIZE_MAX;
+
+        static int8_t tagOf(uint64_t hash) { return static_cast<int8_t>(hash & 0x7f); }
+        static uint32_t homeOf(uint64_t hash) { return static_cast<uint32_t>(hash >> 7); }
+
+        static size_t bucketsFor(size_t expected)
+        {
+            size_t buckets = kGroup;
+            while (buckets * 3 < expected * 4)
+            {
+                buckets <<= 1;
+            }
+            return buckets;
+        }
+
+        static unsigned lowestBit(uint32_t bits)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return static_cast<unsigned>(__builtin_ctz(bits));
+#else
+            unsigned n = 0;
+            while (!(bits & 1))
+            {
+                bits >>= 1;
+                ++n;
+            }
+            return n;
+#endif
+        }
+
+        // bit i set when control byte pos + i equals tag; ctrl_ mirrors its first group past the end,
+        // so the 16-byte load never wraps
+        uint32_t match(size_t pos, int8_t tag) const
+        {
+#if defined(__SSE2__)
+            __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl_.data() + pos));
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag))));
+#else
+            uint32_t bits = 0;
+            for (size_t i = 0; i < kGroup; ++i)
+            {
+                bits |= static_cast<uint32_t>(ctrl_[pos + i] == tag) << i;
+            }
+            return bits;
+#endif
+        }
+
+        size_t locate(uint64_t hash, SlotIndex slot) const
+        {
+            int8_t tag = tagOf(hash);
+            for (size_t pos = homeOf(hash) & mask_;; pos = (pos + kGroup) & mask_)
+            {
+                for (uint32_t hits = match(pos, tag); hits; hits &= hits - 1)
+                {
+                    size_t at = (pos + lowestBit(hits)) & mask_;
+                    if (entries_[at].slot == slot) return at;
+                }
+                if (match(pos, kEmpty)) return kNotFound;
+            }
+        }
+
+        // first empty bucket at or after the home bucket
+        void place(int8_t tag, const Entry &entry)
+        {
+            for (size_t pos = entry.home & mask_;; pos = (pos + kGroup) & mask_)
+            {
+                uint32_t empties = match(pos, kEmpty);
+                if (empties)
+                {
+                    size_t at = (pos + lowestBit(empties)) & mask_;
+                    setCtrl(at, tag);
+                    entries_[at] = entry;
+                    return;
+                }
+            }
+        }
+
+        void setCtrl(size_t at, int8_t tag)
+        {
+            ctrl_[at] = tag;
+            if (at < kGroup) ctrl_[mask_ + 1 + at] = tag;
+        }
+
+        void rehash(size_t buckets)
+        {
+            std::vector<int8_t> ctrl(buckets + kGroup, kEmpty);
+            std::vector<Entry> entries(buckets);
+            ctrl.swap(ctrl_);
+            entries.swap(entries_);
+            size_t oldBuckets = mask_ + 1;
+            mask_ = buckets - 1;
+            if (size_ == 0) return;
+            for (size_t i = 0; i < oldBuckets; ++i)
+            {
+                if (ctrl[i] != kEmpty) place(ctrl[i], entries[i]);
+            }
+        }
+
+        std::vector<int8_t> ctrl_;  // buckets + kGroup control bytes, the tail mirrors the first group
+        std::vector<Entry> entries_;
+        size_t mask_ = 0;
+        size_t size_;
+        Hash hasher_;
+    };
+}  // namespace MeltiCache
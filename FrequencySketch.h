@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Hasher.h"
+
+namespace MeltiCache
+{
+    // Count-min sketch of 4-bit counters used by TinyLFU to estimate how often a key was seen recently.
+    // Each 64-bit word holds 16 counters split into four groups; row i of the sketch uses group i of a word
+    // picked by its own hash, so one estimate touches four words and no counter is shared between rows.
+    // Counters saturate at 15. After sampleSize increments every counter is halved, which ages the
+    // history so that keys that were popular long ago lose against keys that are popular now.
+    template <typename Key>
+    class FrequencySketch
+    {
+      public:
+        explicit FrequencySketch(size_t capacity) : additions_(0) { ensureCapacity(capacity); }
+
+        // sizes the table for about one word per cached entry and resets all counts
+        void ensureCapacity(size_t capacity)
+        {
+            size_t words = 1;
+            while (words < capacity)
+            {
+                words <<= 1;
+            }
+            table_.assign(words, 0);
+            mask_ = words - 1;
+            sampleSize_ = capacity ? 10 * capacity : 10;
+            additions_ = 0;
+        }
+
+        // estimated number of recent occurrences, 0..15
+        unsigned frequency(const Key &key) const { return frequencyHash(Hasher<Key>{}(key)); }
+
+        void increment(const Key &key) { incrementHash(Hasher<Key>{}(key)); }
+
+        // same as above for a key whose Hasher<Key> hash the caller already holds
+        unsigned frequencyHash(uint64_t hash) const
+        {
+            unsigned frequency = kMaxCount;
+            for (unsigned row = 0; row < kRows; ++row)
+            {
+                unsigned count = static_cast<unsigned>((table_[indexOf(hash, row)] >> offsetOf(hash, row)) & kMaxCount);
+                frequency = count < frequency ? count : frequency;
+            }
+            return frequency;
+        }
+
+        void incrementHash(uint64_t hash)
+        {
+            bool added = false;
+            for (unsigned row = 0; row < kRows; ++row)
+            {
+                uint64_t &word = table_[indexOf(hash, row)];
+                unsigned offset = offsetOf(hash, row);
+                if (((word >> offset) & kMaxCount) != kMaxCount)
+                {
+                    word += uint64_t(1) << offset;
+                    added = true;
+                }
+            }
+            if (added && ++additions_ >= sampleSize_)
+            {
+                halve();
+            }
+        }
+
+      private:
+        static constexpr unsigned kRows = 4;
+        static constexpr uint64_t kMaxCount = 15;
+        static constexpr uint64_t kSeeds[kRows] = {0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL,
+                                                   0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL};
+
+        size_t indexOf(uint64_t hash, unsigned row) const
+        {
+            uint64_t h = (hash + kSeeds[row]) * kSeeds[row];
+            h += h >> 32;
+            return static_cast<size_t>(h) & mask_;
+        }
+
+        // counter (hash-picked) inside the row's group of four, as a bit offset in the word
+        static unsigned offsetOf(uint64_t hash, unsigned row)
+        {
+            unsigned counter = row * 4 + static_cast<unsigned>((hash >> (row * 8)) & 3);
+            return counter * 4;
+        }
+
+        void halve()
+        {
+            for (uint64_t &word : table_)
+            {
+                word = (word >> 1) & 0x7777777777777777ULL;
+            }
+            additions_ /= 2;
+        }
+
+        std::vector<uint64_t> table_;
+        size_t mask_;
+        size_t sampleSize_;  // increments between two halvings
+        size_t additions_;
+    };
+}  // namespace MeltiCache
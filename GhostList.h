@@ -0,0 +1,177 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Hasher.h"
+
+namespace MeltiCache
+{
+    // ARC ghost list that remembers evicted keys by a 64-bit fingerprint only: a FIFO ring of fingerprints
+    // (plus their weights when the cache has a weigher) and an open-addressed set to answer contains() in O(1).
+    // No key or value is kept, so a ghost entry costs about 40 bytes (8 in the ring, two 16-byte set slots)
+    // whatever the size of the entry it stands for.
+    // A key evicted again while still remembered is pushed again; the set counts duplicates, so it stays
+    // a ghost until its newest occurrence falls off the ring.
+    // Two keys with the same fingerprint are indistinguishable, which at worst mis-steers one adaptation step.
+    template <typename Key>
+    class GhostList
+    {
+      public:
+        // capacity is in weight units, weighted: keep per-entry weights (otherwise every entry weighs 1)
+        explicit GhostList(size_t capacity, bool weighted = false)
+            : capacity_(capacity), weighted_(weighted), head_(0), count_(0), weight_(0)
+        {
+            size_t slots = 8;
+            while (!weighted && slots < capacity)
+            {
+                slots <<= 1;
+            }
+            ring_.resize(slots);
+            if (weighted) weights_.resize(slots);
+            table_.resize(2 * slots);
+        }
+
+        bool contains(const Key &key) const { return containsHash(Hasher<Key>{}(key)); }
+        // hash is Hasher<Key> of the key, as cached in the evicted node
+        bool containsHash(uint64_t hash) const { return find(fingerprint(hash)) != kNotFound; }
+
+        void push(const Key &key, size_t weight = 1) { pushHash(Hasher<Key>{}(key), weight); }
+
+        // remembers an evicted key, then forgets the oldest ones until the ghost fits its budget again
+        void pushHash(uint64_t hash, size_t weight = 1)
+        {
+            if (capacity_ == 0) return;
+            // unweighted, the ring holds exactly capacity entries: make room first so it never has to grow
+            if (!weighted_ && count_ == capacity_) popOldest();
+            if (count_ == ring_.size()) growRing();
+            uint64_t fp = fingerprint(hash);
+            size_t at = (head_ + count_) & (ring_.size() - 1);
+            ring_[at] = fp;
+            if (weighted_) weights_[at] = weight;
+            ++count_;
+            weight_ += weighted_ ? weight : 1;
+            insert(fp);
+            // the count bound only matters for zero-weight entries, which would otherwise never leave
+            while (count_ > 0 && (weight_ > capacity_ || count_ > capacity_))
+            {
+                popOldest();
+            }
+        }
+
+        size_t weight() const { return weight_; }
+        size_t size() const { return count_; }
+
+        // visits the remembered fingerprints oldest first, fn(hash, weight); pushing them back into an empty
+        // list in that order (pushHash accepts a fingerprint as its hash) rebuilds it, for snapshots
+        template <typename Fn>
+        void forEach(Fn &&fn) const
+        {
+            for (size_t i = 0; i < count_; ++i)
+            {
+                size_t at = (head_ + i) & (ring_.size() - 1);
+                fn(ring_[at], weighted_ ? weights_[at] : size_t(1));
+            }
+        }
+
+      private:
+        struct Entry
+        {
+            uint64_t fp = 0;  // 0 marks an empty slot, fingerprints are never 0
+            uint32_t count = 0;
+        };
+
+        static constexpr size_t kNotFound = SIZE_MAX;
+
+        static uint64_t fingerprint(uint64_t hash) { return hash ? hash : 1; }
+
+        size_t mask() const { return table_.size() - 1; }
+
+        size_t find(uint64_t fp) const
+        {
+            for (size_t i = fp & mask();; i = (i + 1) & mask())
+            {
+                if (table_[i].fp == fp) return i;
+                if (table_[i].fp == 0) return kNotFound;
+            }
+        }
+
+        void insert(uint64_t fp)
+        {
+            size_t i = fp & mask();
+            while (table_[i].fp != 0 && table_[i].fp != fp)
+            {
+                i = (i + 1) & mask();
+            }
+            table_[i].fp = fp;
+            ++table_[i].count;
+        }
+
+        // linear probing without tombstones: after emptying a slot, shift back the entries of its cluster
+        // that could not sit in their home slot
+        void erase(uint64_t fp)
+        {
+            size_t hole = find(fp);
+            if (hole == kNotFound || --table_[hole].count > 0) return;
+            for (size_t i = (hole + 1) & mask(); table_[i].fp != 0; i = (i + 1) & mask())
+            {
+                size_t home = table_[i].fp & mask();
+                // move i into the hole unless its home lies cyclically in (hole, i]
+                bool stays = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+                if (!stays)
+                {
+                    table_[hole] = table_[i];
+                    hole = i;
+                }
+            }
+            table_[hole] = Entry();
+        }
+
+        void popOldest()
+        {
+            erase(ring_[head_]);
+            weight_ -= weighted_ ? weights_[head_] : 1;
+            head_ = (head_ + 1) & (ring_.size() - 1);
+            --count_;
+        }
+
+        // only a weighted ghost outgrows its initial ring: light entries fit more of them in the budget
+        void growRing()
+        {
+            std::vector<uint64_t> ring(2 * ring_.size());
+            std::vector<size_t> weights(weighted_ ? ring.size() : 0);
+            for (size_t i = 0; i < count_; ++i)
+            {
+                size_t from = (head_ + i) & (ring_.size() - 1);
+                ring[i] = ring_[from];
+                if (weighted_) weights[i] = weights_[from];
+            }
+            ring_.swap(ring);
+            weights_.swap(weights);
+            head_ = 0;
+
+            std::vector<Entry> old(2 * ring_.size());
+            table_.swap(old);
+            for (const Entry &entry : old)
+            {
+                if (entry.fp == 0) continue;
+                size_t i = entry.fp & mask();
+                while (table_[i].fp != 0)
+                {
+                    i = (i + 1) & mask();
+                }
+                table_[i] = entry;
+            }
+        }
+
+        size_t capacity_;
+        bool weighted_;
+        std::vector<uint64_t> ring_;  // fingerprints, oldest at head_, power-of-two size
+        std::vector<size_t> weights_;  // parallel to ring_, only with a weigher
+        size_t head_;
+        size_t count_;
+        size_t weight_;
+        std::vector<Entry> table_;  // at most half full: twice the ring size
+    };
+}  // namespace MeltiCache
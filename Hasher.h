@@ -0,0 +1,148 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace MeltiCache
+{
+    // 64-bit hash used by every layer of the cache: ShardedCache picks the shard from the high bits, FlatIndex
+    // the home bucket and control tag from the low bits, GhostList and FrequencySketch use it as the key's
+    // fingerprint. It is computed once per operation and stored in the node, so eviction never rehashes.
+    // Specialize Hasher<Key> to plug in a better hash for a key type; the result must be well mixed in all
+    // 64 bits, the tables do not mix it again.
+
+    // murmur3 finalizer, turns std::hash's identity hash of integers into spread bits
+    inline uint64_t mix64(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    namespace detail
+    {
+        constexpr uint64_t kWyP0 = 0xa0761d6478bd642fULL;
+        constexpr uint64_t kWyP1 = 0xe7037ed1a0b428dbULL;
+        constexpr uint64_t kWyP2 = 0x8ebc6af09c88c6e3ULL;
+        constexpr uint64_t kWyP3 = 0x589965cc75374cc3ULL;
+
+        inline void wyMultiply(uint64_t &a, uint64_t &b)
+        {
+#if defined(__SIZEOF_INT128__)
+            unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+            a = static_cast<uint64_t>(r);
+            b = static_cast<uint64_t>(r >> 64);
+#else
+            uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+            uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+            uint64_t c = t < rl;
+            uint64_t lo = t + (rm1 << 32);
+            c += lo < t;
+            a = lo;
+            b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+        }
+
+        inline uint64_t wyMix(uint64_t a, uint64_t b)
+        {
+            wyMultiply(a, b);
+            return a ^ b;
+        }
+
+        inline uint64_t read64(const uint8_t *p)
+        {
+            uint64_t v;
+            std::memcpy(&v, p, 8);
+            return v;
+        }
+
+        inline uint64_t read32(const uint8_t *p)
+        {
+            uint32_t v;
+            std::memcpy(&v, p, 4);
+            return v;
+        }
+    }  // namespace detail
+
+    // wyhash (Wang Yi, final version 4): 16 bytes per multiply, a handful of instructions for short keys
+    inline uint64_t hashBytes(const void *data, size_t len, uint64_t seed = 0)
+    {
+        using namespace detail;
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        seed ^= wyMix(seed ^ kWyP0, kWyP1);
+        uint64_t a;
+        uint64_t b;
+        if (len <= 16)
+        {
+            if (len >= 4)
+            {
+                size_t step = (len >> 3) << 2;
+                a = (read32(p) << 32) | read32(p + step);
+                b = (read32(p + len - 4) << 32) | read32(p + len - 4 - step);
+            }
+            else if (len > 0)
+            {
+                a = (uint64_t(p[0]) << 16) | (uint64_t(p[len >> 1]) << 8) | p[len - 1];
+                b = 0;
+            }
+            else
+            {
+                a = b = 0;
+            }
+        }
+        else
+        {
+            size_t i = len;
+            if (i > 48)
+            {
+                uint64_t see1 = seed;
+                uint64_t see2 = seed;
+                do
+                {
+                    seed = wyMix(read64(p) ^ kWyP1, read64(p + 8) ^ seed);
+                    see1 = wyMix(read64(p + 16) ^ kWyP2, read64(p + 24) ^ see1);
+                    see2 = wyMix(read64(p + 32) ^ kWyP3, read64(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16)
+            {
+                seed = wyMix(read64(p) ^ kWyP1, read64(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = read64(p + i - 16);
+            b = read64(p + i - 8);
+        }
+        a ^= kWyP1;
+        b ^= seed;
+        wyMultiply(a, b);
+        return wyMix(a ^ kWyP0 ^ len, b ^ kWyP1);
+    }
+
+    template <typename Key>
+    struct Hasher
+    {
+        uint64_t operator()(const Key &key) const { return mix64(static_cast<uint64_t>(std::hash<Key>{}(key))); }
+    };
+
+    template <>
+    struct Hasher<std::string>
+    {
+        uint64_t operator()(const std::string &key) const { return hashBytes(key.data(), key.size()); }
+    };
+
+    template <>
+    struct Hasher<std::string_view>
+    {
+        uint64_t operator()(std::string_view key) const { return hashBytes(key.data(), key.size()); }
+    };
+}  // namespace MeltiCache
@@ -1,14 +1,213 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Hasher.h"
+#include "SingleFlight.h"
+#include "ValueHandle.h"
 
 namespace MeltiCache
 {
+    // 可选的权重函数，比如返回value占的字节数；配了它之后容量就是权重预算而不是条目数
+    template <typename Key,typename Value>
+    using Weigher = std::function<size_t(const Key&,const Value&)>;
+
+    // 没有配权重函数时每个条目按1算，容量退化成条目数
+    template <typename Key,typename Value>
+    size_t weightOf(const Weigher<Key,Value>& weigher,const Key& key,const Value& value)
+    {
+        return weigher ? weigher(key,value) : 1;
+    }
+
+    // 批量接口交给一个分片的那部分：第i个元素是下标order[i]处的key，i取[begin,end)；order为空时就是下标i本身
+    // 分片层按分片排好下标后直接传视图，key/value不用再拷贝成每个分片一份
+    struct BatchRange
+    {
+        const size_t* order = nullptr;
+        size_t begin = 0;
+        size_t end = 0;
+
+        size_t operator[](size_t i) const { return order ? order[i] : i; }
+        size_t size() const { return end - begin; }
+    };
+
     template <typename Key,typename Value>
     class ICachePolicy
     {
-        virtual void put(Key key,Value value) = 0;
-        virtual bool get(Key key,Value& value) = 0;
-        virtual Value get(Key key) = 0;
+      public:
+        virtual ~ICachePolicy() = default;
+
+        virtual void put(const Key& key, const Value& value) = 0;
+        virtual bool get(const Key& key, Value& value) = 0;
+        virtual Value get(const Key& key) = 0;
+
+        // 当前缓存内所有条目的权重和，没有权重函数时就是条目数
+        virtual size_t weightedSize() = 0;
+
+        // 带着调用方已经算好的哈希读写，hash必须是MeltiCache::Hasher<Key>对这个key的结果
+        // 分片层算一次哈希后一路传到索引探测，不再重复计算；默认忽略hash，节点池里的策略覆盖成直接用它
+        virtual bool getWithHash(const Key& key, uint64_t hash, Value& value)
+        {
+            (void)hash;
+            return get(key,value);
+        }
+
+        virtual void putWithHash(const Key& key, uint64_t hash, const Value& value)
+        {
+            (void)hash;
+            put(key,value);
+        }
+
+        // 右值写入：各策略覆盖成把key/value直接移动进节点，默认退化成拷贝
+        virtual void put(Key&& key, Value&& value)
+        {
+            put(static_cast<const Key&>(key),static_cast<const Value&>(value));
+        }
+
+        // 带哈希的右值写入；覆盖了putWithHash的策略要把两个重载一起覆盖，否则右值调用会落到拷贝的那个上
+        virtual void putWithHash(Key&& key, uint64_t hash, Value&& value)
+        {
+            (void)hash;
+            put(std::move(key),std::move(value));
+        }
+
+        // key不存在时才用makeValue造出value写入，已存在时不构造也不算一次访问，返回是否写入
+        // 默认实现先查后写不是原子的，各策略覆盖成一次加锁完成
+        virtual bool insertIfAbsent(const Key& key, const std::function<Value()>& makeValue)
+        {
+            Value value{};
+            if (get(key,value))
+            {
+                return false;
+            }
+            put(key,makeValue());
+            return true;
+        }
+
+        virtual bool insertIfAbsentWithHash(const Key& key, uint64_t hash, const std::function<Value()>& makeValue)
+        {
+            (void)hash;
+            return insertIfAbsent(key,makeValue);
+        }
+
+        // 用args就地构造value，再整体移动进缓存节点，value只移动一次
+        template <typename K, typename... Args>
+        void emplace(K&& key, Args&&... args)
+        {
+            put(Key(std::forward<K>(key)),Value(std::forward<Args>(args)...));
+        }
+
+        // 同std::map::try_emplace：key已存在时args原样不动
+        template <typename... Args>
+        bool tryEmplace(const Key& key, Args&&... args)
+        {
+            return insertIfAbsent(key,[&]() { return Value(std::forward<Args>(args)...); });
+        }
+
+        // 零拷贝读：返回只读句柄，未命中时句柄为空
+        // 默认实现拷贝一份放进shared_ptr，节点池里的策略覆盖成直接指向节点并钉住槽位
+        virtual ValueHandle<Value> getHandle(const Key& key)
+        {
+            Value value{};
+            if (!get(key,value))
+            {
+                return ValueHandle<Value>();
+            }
+            return ValueHandle<Value>(std::make_shared<const Value>(std::move(value)));
+        }
+
+        virtual ValueHandle<Value> getHandleWithHash(const Key& key, uint64_t hash)
+        {
+            (void)hash;
+            return getHandle(key);
+        }
+
+        // 批量读：values/found 和 keys 按下标一一对应，返回命中个数
+        // 整批的哈希在进任何锁之前算好，再交给getManyWithHash
+        virtual size_t getMany(const std::vector<Key>& keys,std::vector<Value>& values,std::vector<bool>& found)
+        {
+            values.resize(keys.size());
+            found.assign(keys.size(),false);
+            std::vector<uint64_t> hashes = hashAll(keys);
+            return getManyWithHash(keys,hashes,BatchRange{nullptr,0,keys.size()},values,found);
+        }
+
+        // 批量写：keys[i]对应values[i]
+        virtual void putMany(const std::vector<Key>& keys,const std::vector<Value>& values)
+        {
+            std::vector<uint64_t> hashes = hashAll(keys);
+            putManyWithHash(keys,hashes,values,BatchRange{nullptr,0,keys.size()});
+        }
+
+        // 只处理range里的下标，hashes[i]是keys[i]的哈希；values/found已由调用方按keys的大小准备好，
+        // 结果写在同一个下标上。默认逐个调用getWithHash，各策略覆盖成整批只加一次锁
+        virtual size_t getManyWithHash(const std::vector<Key>& keys,const std::vector<uint64_t>& hashes,
+                                       BatchRange range,std::vector<Value>& values,std::vector<bool>& found)
+        {
+            size_t hits = 0;
+            for (size_t i = range.begin; i < range.end; ++i)
+            {
+                size_t at = range[i];
+                found[at] = getWithHash(keys[at],hashes[at],values[at]);
+                hits += found[at];
+            }
+            return hits;
+        }
+
+        virtual void putManyWithHash(const std::vector<Key>& keys,const std::vector<uint64_t>& hashes,
+                                     const std::vector<Value>& values,BatchRange range)
+        {
+            for (size_t i = range.begin; i < range.end; ++i)
+            {
+                size_t at = range[i];
+                putWithHash(keys[at],hashes[at],values[at]);
+            }
+        }
+
+        // 读穿：未命中时调用loader(key)加载并写入缓存。同一个key并发未命中时只有一个线程调用loader，
+        // 其余线程等它的结果，不会一起打到后端再一起put
+        // loader在策略的锁之外运行；loader抛异常时什么都不写，同一批等待者都收到这个异常，下次调用重新加载
+        template <typename Loader>
+        Value getOrLoad(const Key& key, Loader&& loader)
+        {
+            uint64_t hash = Hasher<Key>{}(key);
+            Value value{};
+            if (getWithHash(key,hash,value))
+            {
+                return value;
+            }
+            return loads_.run(key,[&]() {
+                Value loaded{};
+                // 前一次加载可能刚写入缓存就结束了，领头的线程先再查一次
+                if (getWithHash(key,hash,loaded))
+                {
+                    return loaded;
+                }
+                loaded = loader(key);
+                putWithHash(key,hash,loaded);
+                return loaded;
+            });
+        }
+
+      protected:
+        static std::vector<uint64_t> hashAll(const std::vector<Key>& keys)
+        {
+            std::vector<uint64_t> hashes(keys.size());
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                hashes[i] = Hasher<Key>{}(keys[i]);
+            }
+            return hashes;
+        }
+
+      private:
+        SingleFlight<Key,Value> loads_;  // 正在加载的key
     };
 
     
-}
\ No newline at end of file
+}
@@ -1,63 +1,122 @@
 #pragma once
+#include "CacheStats.h"
+#include "FlatIndex.h"
 #include "ICachePolicy.h"
+#include "NodePool.h"
+#include "TimerWheel.h"
 #include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <type_traits>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 template <typename Key, typename Value>
 class LfuCache;
+// 同一频数的节点组成的链表，不再单独new出来，而是作为LfuCache里频数表的一格
 template <typename Key, typename Value>
 class Freqlist {
   private:
     struct Node {
-        int freq_;
+        uint32_t freq_;     //访问频数，包含写入时的老化基准(按2^32回绕)，真实频数见LfuCache::effectiveFreq
+        size_t weight_;     //写入时按权重函数算出的权重
+        uint64_t hash_;     //key的哈希，删除时直接用它找索引，不用再算
         Key key_;
         Value value_;
-        std::weak_ptr<Node> pre_;
-        std::shared_ptr<Node> next_;
+        MeltiCache::SlotIndex pre_;
+        MeltiCache::SlotIndex next_;
 
-        Node() : freq_(1), next_(nullptr) {}
-        Node(Key key, Value value) : freq_(1), key_(key), value_(value), next_(nullptr) {}
+        Node()
+            : freq_(1), weight_(1), hash_(0), key_(), value_(), pre_(MeltiCache::kNullSlot),
+              next_(MeltiCache::kNullSlot) {}
+        //槽位回到池里时释放key和value持有的内存，节点对象本身留着复用
+        void clear() {
+            key_ = Key();
+            value_ = Value();
+        }
     };
 
-    //定义完Node要把Node连接起来形成list
-    using NodePtr = std::shared_ptr<Node>;
-    //当前list的访问频率
-    int freq_;
-    //创建收尾节点目的：如果首尾节点挨着，说明当前频率下没有对应的节点
-    NodePtr head_;
-    NodePtr tail_;
+    //定义完Node要把Node连接起来形成list，节点都放在LfuCache的节点池里，这里只记槽位
+    using NodePool = MeltiCache::NodePool<Node>;
+    using Slot = MeltiCache::SlotIndex;
+    //首尾节点直接记槽位，不再占用哨兵节点；head_为空说明当前频率下没有对应的节点
+    Slot head_;
+    Slot tail_;
+    int size_;  //当前list里的节点数，老化时用来精确扣减总频数
 
   public:
-    Freqlist(int freq) : freq_(freq) {
-        head_ = std::make_shared<Node>();
-        tail_ = std::make_shared<Node>();
-        head_->next_ = tail_;
-        tail_->pre_ = head_;
+    Freqlist() : head_(MeltiCache::kNullSlot), tail_(MeltiCache::kNullSlot), size_(0) {}
+
+    void addNode(NodePool &pool, Slot node) {
+        Node &cur = pool[node];
+        cur.pre_ = tail_;
+        cur.next_ = MeltiCache::kNullSlot;
+        if (tail_ != MeltiCache::kNullSlot)
+            pool[tail_].next_ = node;
+        else
+            head_ = node;
+        tail_ = node;
+        ++size_;
     }
 
-    void addNode(NodePtr node) {
-        node->pre_ = tail_->pre_;
-        node->next_ = tail_;
-        tail_->pre_.lock()->next_ = node; // 使用lock()获取shared_ptr
-        tail_->pre_ = node;
+    void removeNode(NodePool &pool, Slot node) {
+        Node &cur = pool[node];
+        if (cur.pre_ != MeltiCache::kNullSlot)
+            pool[cur.pre_].next_ = cur.next_;
+        else
+            head_ = cur.next_;
+        if (cur.next_ != MeltiCache::kNullSlot)
+            pool[cur.next_].pre_ = cur.pre_;
+        else
+            tail_ = cur.pre_;
+        cur.pre_ = MeltiCache::kNullSlot;
+        cur.next_ = MeltiCache::kNullSlot;
+        --size_;
+    }
+
+    //把other整条链接到当前list前面，other清空
+    void prependList(NodePool &pool, Freqlist &other) {
+        if (other.isEmpty())
+            return;
+        if (isEmpty()) {
+            tail_ = other.tail_;
+        } else {
+            pool[other.tail_].next_ = head_;
+            pool[head_].pre_ = other.tail_;
+        }
+        head_ = other.head_;
+        size_ += other.size_;
+        other = Freqlist();
     }
 
-    void removeNode(NodePtr node) {
-        auto preNode = node->pre_.lock();
-        preNode->next_ = node->next_;
-        node->next_->pre_ = preNode;
-        node->next_ = nullptr;
+    //用新节点原地顶替旧节点，前后顺序不变
+    void replaceNode(NodePool &pool, Slot old, Slot node) {
+        Node &prev = pool[old];
+        Node &cur = pool[node];
+        cur.pre_ = prev.pre_;
+        cur.next_ = prev.next_;
+        if (cur.pre_ != MeltiCache::kNullSlot)
+            pool[cur.pre_].next_ = node;
+        else
+            head_ = node;
+        if (cur.next_ != MeltiCache::kNullSlot)
+            pool[cur.next_].pre_ = node;
+        else
+            tail_ = node;
+        prev.pre_ = MeltiCache::kNullSlot;
+        prev.next_ = MeltiCache::kNullSlot;
     }
+
     bool isEmpty() {
-        return head_->next_ == tail_;
+        return head_ == MeltiCache::kNullSlot;
     }
 
-    NodePtr getFirstNode() {
-        return head_->next_;
+    Slot getFirstNode() {
+        return head_;
     }
 
     friend class LfuCache<Key, Value>;
@@ -67,89 +126,405 @@ class LfuCache : public MeltiCache::ICachePolicy<Key, Value> {
 
   public:
     using Node = typename Freqlist<Key, Value>::Node;
-    using NodePtr = std::shared_ptr<Node>;
-    using NodeMap = std::unordered_map<Key, NodePtr>;
+    using NodePool = typename Freqlist<Key, Value>::NodePool;
+    using Slot = MeltiCache::SlotIndex;
+    using NodeMap = MeltiCache::FlatIndex<Key>;
+    using Weigher = MeltiCache::Weigher<Key, Value>;
+    using Duration = MeltiCache::TimerWheel::Duration;
 
     LfuCache(int capacity, int maxAverageNum)
-        : capacity_(capacity), minFreq_(INT8_MAX), maxAverageNum_(maxAverageNum),
-          curAverageNum_(0), curTotalNum_(0) {}
-
-    void put(Key key, Value value) override {
-        auto it = nodeMap_.find(key);
-        if (it != nodeMap_.end()) {
-            it->second->value_ = value;
-            //修改freqList里面的位置
-            updateNodeFrequency(it->second);
+        : capacity_(capacity > 0 ? capacity : 0), weightedSize_(0),
+          maxAverageNum_(std::min(maxAverageNum, freqLimit(maxAverageNum) / 2)), minFreq_(1), curAverageNum_(0),
+          curTotalNum_(0), agingBase_(0), maxFreq_(freqLimit(maxAverageNum)),
+          pool_(capacity > 0 ? capacity : 1) {
+        nodeMap_.reserve(capacity_);
+        initFreqTable();
+    }
+
+    //按权重计容量：maxWeight是权重预算(比如字节数)，淘汰一直进行到总权重放得下为止
+    LfuCache(size_t maxWeight, int maxAverageNum, Weigher weigher)
+        : capacity_(maxWeight), weightedSize_(0), weigher_(std::move(weigher)),
+          maxAverageNum_(std::min(maxAverageNum, freqLimit(maxAverageNum) / 2)), minFreq_(1), curAverageNum_(0),
+          curTotalNum_(0), agingBase_(0), maxFreq_(freqLimit(maxAverageNum)),
+          pool_(1) {
+        initFreqTable();
+    }
+
+    void put(const Key &key, const Value &value) override { LfuCache::putWithHash(key, nodeMap_.hash(key), value); }
+    //哈希在加锁之前算好，锁内只剩探测和频数list操作
+    void putWithHash(const Key &key, uint64_t hash, const Value &value) override {
+        if (capacity_ == 0)
             return;
-        }
-        putInternal(key, value);
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        putEntry(key, value, hash, 0);
+    }
+    //key和value都直接移动进池里的节点
+    void put(Key &&key, Value &&value) override {
+        uint64_t hash = nodeMap_.hash(key);
+        LfuCache::putWithHash(std::move(key), hash, std::move(value));
+    }
+    void putWithHash(Key &&key, uint64_t hash, Value &&value) override {
+        if (capacity_ == 0)
+            return;
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        putEntry(std::move(key), std::move(value), hash, 0);
+    }
+    //单条ttl，覆盖默认的过期时间
+    void put(const Key &key, const Value &value, Duration ttl) { putWithHash(key, nodeMap_.hash(key), value, ttl); }
+    void put(Key &&key, Value &&value, Duration ttl) {
+        uint64_t hash = nodeMap_.hash(key);
+        putWithHash(std::move(key), hash, std::move(value), ttl);
+    }
+    void putWithHash(const Key &key, uint64_t hash, const Value &value, Duration ttl) {
+        if (capacity_ == 0)
+            return;
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        expiring_ = true;
+        putEntry(key, value, hash, toNanos(ttl));
+    }
+    void putWithHash(Key &&key, uint64_t hash, Value &&value, Duration ttl) {
+        if (capacity_ == 0)
+            return;
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        expiring_ = true;
+        putEntry(std::move(key), std::move(value), hash, toNanos(ttl));
+    }
+    //写入ttl之后过期；设置过过期时间之后，每次读写都要读一次时钟
+    void setExpireAfterWrite(Duration ttl) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        expireAfterWrite_ = toNanos(ttl);
+        expiring_ = true;
+    }
+    //ttl内没有被读写就过期，每次访问都会把过期时间顺延
+    void setExpireAfterAccess(Duration ttl) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        expireAfterAccess_ = toNanos(ttl);
+        expiring_ = true;
+    }
+    //推进时间轮，把所有到期的条目一次性回收；写入时也会顺带做一次
+    void cleanUp() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (expiring_)
+            expireEntries(MeltiCache::TimerWheel::now());
+    }
+    bool insertIfAbsent(const Key &key, const std::function<Value()> &makeValue) override {
+        return LfuCache::insertIfAbsentWithHash(key, nodeMap_.hash(key), makeValue);
     }
-    bool get(Key key, Value &value) override {
-        auto node = nodeMap_.find(key);
-        if (node != nodeMap_.end()) {
-            getInternal(node->second, value);
+    bool insertIfAbsentWithHash(const Key &key, uint64_t hash, const std::function<Value()> &makeValue) override {
+        if (capacity_ == 0)
+            return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t now = expiring_ ? MeltiCache::TimerWheel::now() : 0;
+        Slot slot = findSlot(key, hash);
+        if (slot != MeltiCache::kNullSlot && (!expiring_ || !wheel_.expired(slot, now)))
+            return false;
+        putEntry(key, makeValue(), hash, 0, now);
+        return true;
+    }
+    bool get(const Key &key, Value &value) override { return LfuCache::getWithHash(key, nodeMap_.hash(key), value); }
+    bool getWithHash(const Key &key, uint64_t hash, Value &value) override {
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot slot = findSlot(key, hash);
+        if (slot != MeltiCache::kNullSlot && (!expiring_ || touchExpiry(slot, MeltiCache::TimerWheel::now()))) {
+            getInternal(slot, value);
+            stats_.record(MeltiCache::CacheStats::Counter::Hits);
             return true;
         } else {
+            stats_.record(MeltiCache::CacheStats::Counter::Misses);
             return false;
         }
     }
 
-    Value get(Key key) override
+    Value get(const Key &key) override
     {
         Value value{};
         get(key,value);
         return value;
     }
 
+    size_t weightedSize() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return weightedSize_;
+    }
+
+    //命中时直接指向池里的节点，不拷贝value
+    MeltiCache::ValueHandle<Value> getHandle(const Key &key) override {
+        return LfuCache::getHandleWithHash(key, nodeMap_.hash(key));
+    }
+    MeltiCache::ValueHandle<Value> getHandleWithHash(const Key &key, uint64_t hash) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot slot = findSlot(key, hash);
+        if (slot == MeltiCache::kNullSlot || (expiring_ && !touchExpiry(slot, MeltiCache::TimerWheel::now()))) {
+            stats_.record(MeltiCache::CacheStats::Counter::Misses);
+            return MeltiCache::ValueHandle<Value>();
+        }
+        stats_.record(MeltiCache::CacheStats::Counter::Hits);
+        updateNodeFrequency(slot);
+        return MeltiCache::ValueHandle<Value>(&pool_[slot].value_, &pool_.pins(slot));
+    }
+
+    //整批只加一次锁，哈希由调用方在锁外算好：先查map并预取节点，再统一读值、更新频数
+    size_t getManyWithHash(const std::vector<Key> &keys, const std::vector<uint64_t> &hashes,
+                           MeltiCache::BatchRange range, std::vector<Value> &values,
+                           std::vector<bool> &found) override {
+        std::vector<Slot> slots(range.size(), MeltiCache::kNullSlot);
+        size_t hits = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t now = expiring_ ? MeltiCache::TimerWheel::now() : 0;
+        for (size_t i = range.begin; i < range.end; ++i) {
+            size_t at = range[i];
+            Slot slot = findSlot(keys[at], hashes[at]);
+            //过期的条目在这一遍就删掉，批里重复出现的同一个key后面就查不到了
+            if (slot != MeltiCache::kNullSlot && (!expiring_ || touchExpiry(slot, now))) {
+                slots[i - range.begin] = slot;
+                pool_.prefetch(slot);
+            }
+        }
+        for (size_t i = range.begin; i < range.end; ++i) {
+            Slot slot = slots[i - range.begin];
+            if (slot == MeltiCache::kNullSlot)
+                continue;
+            getInternal(slot, values[range[i]]);
+            found[range[i]] = true;
+            ++hits;
+        }
+        stats_.record(MeltiCache::CacheStats::Counter::Hits, hits);
+        stats_.record(MeltiCache::CacheStats::Counter::Misses, range.size() - hits);
+        return hits;
+    }
+
+    void putManyWithHash(const std::vector<Key> &keys, const std::vector<uint64_t> &hashes,
+                         const std::vector<Value> &values, MeltiCache::BatchRange range) override {
+        if (capacity_ == 0)
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t now = expiring_ ? MeltiCache::TimerWheel::now() : 0;
+        for (size_t i = range.begin; i < range.end; ++i) {
+            size_t at = range[i];
+            putEntry(keys[at], values[at], hashes[at], 0, now);
+        }
+    }
+
+    //命中/未命中/写入/淘汰/过期计数，开了采样时还有延迟直方图；计数不加锁读
+    MeltiCache::CacheStatsSnapshot stats() {
+        MeltiCache::CacheStatsSnapshot snapshot;
+        stats_.fill(snapshot);
+        return snapshot;
+    }
+    //每个线程每period次读写计时一次，0为关闭
+    void setLatencySampling(uint32_t period) { stats_.setLatencySampling(period); }
+    //把老化基准挪到base，只对空缓存生效；基准按2^32回绕，测试用它直接从回绕点附近开始
+    void resetAgingBase(uint32_t base) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (nodeMap_.empty())
+            agingBase_ = base;
+    }
+
   private:
-    void getInternal(NodePtr node, Value &value);
-    void putInternal(Key key, Value value);
-    void updateNodeFrequency(NodePtr node);
-    void removeFromFreqList(NodePtr node);
-    void addToFreqList(NodePtr node);
+    static uint64_t toNanos(Duration ttl) { return ttl.count() > 0 ? static_cast<uint64_t>(ttl.count()) : 0; }
+    //在索引里查key所在的槽位，没有时返回kNullSlot；比较key时直接读池里的节点
+    Slot findSlot(const Key &key, uint64_t hash) const {
+        return nodeMap_.find(hash, [&](Slot slot) { return pool_[slot].key_ == key; });
+    }
+    Slot findSlot(const Key &key) const { return findSlot(key, nodeMap_.hash(key)); }
+    static int freqLimit(int maxAverageNum);
+    void initFreqTable();
+    template <typename K, typename V>
+    void putEntry(K &&key, V &&value, uint64_t hash, uint64_t ttl, uint64_t now = 0);
+    bool touchExpiry(Slot node, uint64_t now);
+    void expireEntries(uint64_t now);
+    template <typename K, typename V>
+    Slot putImpl(K &&key, V &&value, uint64_t hash);
+    void getInternal(Slot node, Value &value);
+    Slot replacePinnedNode(Slot old);
+    template <typename K, typename V>
+    Slot putInternal(K &&key, V &&value, uint64_t hash);
+    void updateNodeFrequency(Slot node);
     void addFreqNum();
     void decreaseFreqNum(int num);
     void handleOverMaxAverageNum();
-    void updateMinFreq();
-    void kickOut();
+    int effectiveFreq(Slot node);
+    Freqlist<Key, Value> &freqList(int freq);
+    void kickOut(Slot keep = MeltiCache::kNullSlot);
+    void removeEntry(Slot node);
+    void releaseNode(Slot node);
 
   private:
-    int capacity_;                                                   //缓存总容量
-    int maxAverageNum_;                                              //最大平均缓存数
+    static constexpr int kMinMaxFreq = 8;                            //单个节点频数上限的最小值
+    static constexpr size_t kMaxFreqLimit = size_t(1) << 16;         //单个节点频数上限的最大值，频数表不超过这么多个list
+
+    size_t capacity_;                                                //缓存总容量，配了权重函数时是权重预算
+    size_t weightedSize_;                                            //当前总权重
+    Weigher weigher_;
+    uint64_t expireAfterWrite_ = 0;                                  //默认写入后过期时间，ns，0表示不过期
+    uint64_t expireAfterAccess_ = 0;                                 //默认访问后过期时间，ns
+    bool expiring_ = false;                                          //有没有条目可能过期，没有时读写都不碰时钟
+    MeltiCache::TimerWheel wheel_;                                   //按槽位挂过期时间的分层时间轮
+    int maxAverageNum_;                                              //最大平均缓存数，超过kMaxFreqLimit/2时封顶，老化在频数封顶前触发
     int minFreq_;                                                    //最小频数
     int curAverageNum_;                                              //当前平均频数
     int curTotalNum_;                                                //当前总缓存数
+    uint32_t agingBase_;                                             //累计老化扣减量，按2^32回绕，节点频数按它懒惰折算
+    int maxFreq_;                                                    //单个节点的频数上限，决定频数表大小
+    NodePool pool_;                                                  //节点池,淘汰的节点回收复用
     NodeMap nodeMap_;                                                //key和节点位置映射
-    std::unordered_map<int, Freqlist<Key, Value> *> freqToFreqList_; //频数和映射的当前频数freqlist
+    std::vector<Freqlist<Key, Value>> freqTable_;                    //按频数连续存放的频数list
+    size_t freqMask_;
+    std::mutex mutex_;
+    MeltiCache::CacheStats stats_;
 };
+//单个节点的频数上限：取 2*maxAverageNum，但不超过 kMaxFreqLimit，maxAverageNum 配得很大也不会开出
+//几十MB的频数表。按size_t算，不会溢出int
+template <typename Key, typename Value>
+int LfuCache<Key, Value>::freqLimit(int maxAverageNum) {
+    size_t limit = std::min(2 * static_cast<size_t>(std::max(maxAverageNum, 0)), kMaxFreqLimit);
+    return static_cast<int>(std::max(limit, static_cast<size_t>(kMinMaxFreq)));
+}
+template <typename Key, typename Value>
+void LfuCache<Key, Value>::initFreqTable() {
+    //频数表大小取不小于maxFreq_的2的幂，下标 = (老化基准 + 频数) & mask，老化时表不用整体搬移
+    size_t tableSize = 1;
+    while (tableSize < static_cast<size_t>(maxFreq_))
+        tableSize <<= 1;
+    freqTable_.resize(tableSize);
+    freqMask_ = tableSize - 1;
+}
+//调用方已持有锁。开了过期时先回收到期条目，再写入并挂上新的过期时间；ttl为0时用默认的
+template <typename Key, typename Value>
+template <typename K, typename V>
+void LfuCache<Key, Value>::putEntry(K &&key, V &&value, uint64_t hash, uint64_t ttl, uint64_t now) {
+    stats_.record(MeltiCache::CacheStats::Counter::Puts);
+    if (!expiring_) {
+        putImpl(std::forward<K>(key), std::forward<V>(value), hash);
+        return;
+    }
+    if (now == 0)
+        now = MeltiCache::TimerWheel::now();
+    expireEntries(now);
+    Slot node = putImpl(std::forward<K>(key), std::forward<V>(value), hash);
+    if (node == MeltiCache::kNullSlot)
+        return;
+    if (ttl == 0)
+        ttl = expireAfterWrite_ ? expireAfterWrite_ : expireAfterAccess_;
+    wheel_.schedule(node, ttl ? now + ttl : 0);
+}
+//命中后检查过期：已经到期的当作未命中并删掉；只配了expire-after-access时顺延过期时间
+template <typename Key, typename Value>
+bool LfuCache<Key, Value>::touchExpiry(Slot node, uint64_t now) {
+    if (wheel_.expired(node, now)) {
+        removeEntry(node);
+        stats_.record(MeltiCache::CacheStats::Counter::Expirations);
+        return false;
+    }
+    if (expireAfterAccess_ && !expireAfterWrite_ && wheel_.deadlineOf(node))
+        wheel_.schedule(node, now + expireAfterAccess_);
+    return true;
+}
 template <typename Key, typename Value>
-void LfuCache<Key, Value>::getInternal(NodePtr node, Value &value) {
-    value = node->value_;
+void LfuCache<Key, Value>::expireEntries(uint64_t now) {
+    size_t expired = 0;
+    wheel_.advance(now, [this, &expired](Slot node) {
+        removeEntry(node);
+        ++expired;
+    });
+    if (expired)
+        stats_.record(MeltiCache::CacheStats::Counter::Expirations, expired);
+}
+template <typename Key, typename Value>
+template <typename K, typename V>
+typename LfuCache<Key, Value>::Slot LfuCache<Key, Value>::putImpl(K &&key, V &&value, uint64_t hash) {
+    Slot slot = findSlot(key, hash);
+    if (slot != MeltiCache::kNullSlot) {
+        size_t weight = MeltiCache::weightOf(weigher_, pool_[slot].key_, static_cast<const Value &>(value));
+        if (weight > capacity_) {
+            //新值单独就超过预算，直接删掉这个key
+            removeEntry(slot);
+            return MeltiCache::kNullSlot;
+        }
+        //旧值还被句柄引用时不能原地覆盖，换一个新节点顶替它在频数list里的位置
+        Slot node = pool_.isPinned(slot) ? replacePinnedNode(slot) : slot;
+        pool_[node].value_ = std::forward<V>(value);
+        weightedSize_ = weightedSize_ - pool_[node].weight_ + weight;
+        pool_[node].weight_ = weight;
+        //修改freqList里面的位置
+        updateNodeFrequency(node);
+        //变重之后可能超出预算，按最小频数淘汰别的节点
+        while (weightedSize_ > capacity_ && nodeMap_.size() > 1)
+            kickOut(node);
+        return node;
+    }
+    return putInternal(std::forward<K>(key), std::forward<V>(value), hash);
+}
+template <typename Key, typename Value>
+void LfuCache<Key, Value>::getInternal(Slot node, Value &value) {
+    value = pool_[node].value_;
     updateNodeFrequency(node);
 }
 
 template <typename Key, typename Value>
-void LfuCache<Key, Value>::putInternal(Key key, Value value) {
-    if (nodeMap_.size() >= capacity_) {
+typename LfuCache<Key, Value>::Slot LfuCache<Key, Value>::replacePinnedNode(Slot old) {
+    Slot node = pool_.allocate();
+    pool_[node].freq_ = pool_[old].freq_;
+    pool_[node].weight_ = pool_[old].weight_;
+    pool_[node].hash_ = pool_[old].hash_;
+    pool_[node].key_ = pool_[old].key_;
+    freqList(effectiveFreq(old)).replaceNode(pool_, old, node);
+    nodeMap_.replace(pool_[node].hash_, old, node);
+    //过期时间跟着搬到新节点上
+    uint64_t deadline = wheel_.deadlineOf(old);
+    wheel_.deschedule(old);
+    wheel_.schedule(node, deadline);
+    releaseNode(old);
+    return node;
+}
+
+template <typename Key, typename Value>
+template <typename K, typename V>
+typename LfuCache<Key, Value>::Slot LfuCache<Key, Value>::putInternal(K &&key, V &&value, uint64_t hash) {
+    size_t weight = MeltiCache::weightOf(weigher_, static_cast<const Key &>(key), static_cast<const Value &>(value));
+    if (weight > capacity_)
+        return MeltiCache::kNullSlot;  //单个条目就超过预算，不缓存
+    //总权重放不下新节点，就一直按最小频数淘汰
+    while (weightedSize_ + weight > capacity_) {
         kickOut();
     }
-    //放入频数1list，检测minfreq是否是1，如果不是变成1且在1list里增加新node
+    //放入频数1list，新节点一定是最小频数
     minFreq_ = 1;
 
-    auto newNode = std::make_shared<Node>(key, value);
-    //add to map
-    nodeMap_[key] = newNode;
-    addToFreqList(newNode);
+    Slot newNode = pool_.allocate();
+    //索引里只记槽位，key只在节点里存一份
+    nodeMap_.insert(hash, newNode);
+    pool_[newNode].hash_ = hash;
+    pool_[newNode].freq_ = agingBase_ + 1;
+    pool_[newNode].weight_ = weight;
+    weightedSize_ += weight;
+    pool_[newNode].key_ = std::forward<K>(key);
+    pool_[newNode].value_ = std::forward<V>(value);
+    freqList(1).addNode(pool_, newNode);
     addFreqNum();
+    return newNode;
 }
 
 template <typename Key, typename Value>
-void LfuCache<Key, Value>::updateNodeFrequency(NodePtr node) {
-    removeFromFreqList(node);
-    node->freq_++;
-    addToFreqList(node);
+void LfuCache<Key, Value>::updateNodeFrequency(Slot node) {
+    //先按老化基准折算出真实频数，再+1，节点被访问时才做这次归一化
+    int freq = effectiveFreq(node);
+    Freqlist<Key, Value> &oldList = freqList(freq);
+    oldList.removeNode(pool_, node);
+    if (freq >= maxFreq_) {
+        //已经到频数上限，只移到同一list尾部，总频数不再增加
+        oldList.addNode(pool_, node);
+        return;
+    }
+    pool_[node].freq_ = agingBase_ + static_cast<uint32_t>(freq + 1);
+    freqList(freq + 1).addNode(pool_, node);
     //判断前序频数是否变为了空，如果是空的minfreq++
-    if (node->freq_ - 1 == minFreq_ && freqToFreqList_[node->freq_ - 1]->isEmpty()) {
+    if (freq == minFreq_ && oldList.isEmpty()) {
         minFreq_++;
     }
     //更新当前总频数和 、 当前平均频数
@@ -169,54 +544,77 @@ void LfuCache<Key, Value>::addFreqNum() {
 }
 template <typename Key, typename Value>
 void LfuCache<Key, Value>::handleOverMaxAverageNum() {
-    //用map遍历节点，找到节点后先移除list修改freq后再加入节点
-    for (auto it = nodeMap_.begin(); it != nodeMap_.end(); ++it) {
-        if (!it->second)
-            continue;
-        auto node = it->second;
-        removeFromFreqList(node);
-        node->freq_ -= maxAverageNum_ / 2;
-        if (node->freq_ < 1)
-            node->freq_ = 1;
-        addToFreqList(node);
-    }
-
-    //遍历list查看更新最小频数
-    updateMinFreq();
-}
-template <typename Key, typename Value>
-void LfuCache<Key, Value>::updateMinFreq() {
-    minFreq_ = INT8_MAX;
-    for (auto &pair : freqToFreqList_) {
-        if (pair.second && !pair.second->isEmpty()) {
-            minFreq_ = std::min(minFreq_, pair.first);
-        }
+    //所有节点频数减去 maxAverageNum_/2 (最低为1)。不再遍历全部节点，只把老化基准上移，
+    //节点自己的频数在下次访问或淘汰时按基准折算，相对顺序不变
+    int decay = maxAverageNum_ / 2;
+    if (decay <= 0)
+        return;
+
+    //总频数的扣减：已经是1的节点不扣，真实频数在(1, decay]之间的节点只扣到1，其余扣decay
+    long long reduce = static_cast<long long>(decay) * (nodeMap_.size() - freqList(1).size_);
+    for (int freq = 2; freq <= decay; ++freq) {
+        reduce -= static_cast<long long>(freqList(freq).size_) * (decay + 1 - freq);
     }
-    if (minFreq_ == INT8_MAX)
-        minFreq_ = 1;
+
+    //频数 1..decay 的list在老化后都变成频数1，按频数从低到高拼到原频数decay+1的list前面，
+    //只动decay个表头，和缓存大小无关；空出来的格子之后给最高的频数复用
+    Freqlist<Key, Value> &floor = freqList(decay + 1);
+    for (int freq = decay; freq >= 1; --freq) {
+        floor.prependList(pool_, freqList(freq));
+    }
+    agingBase_ += static_cast<uint32_t>(decay);
+    minFreq_ = std::max(1, minFreq_ - decay);
+
+    curTotalNum_ -= static_cast<int>(reduce);
+    curAverageNum_ = nodeMap_.empty() ? 0 : curTotalNum_ / static_cast<int>(nodeMap_.size());
 }
 template <typename Key, typename Value>
-void LfuCache<Key, Value>::removeFromFreqList(NodePtr node) {
-    freqToFreqList_[node->freq_]->removeNode(node);
+int LfuCache<Key, Value>::effectiveFreq(Slot node) {
+    //无符号相减按2^32回绕，老化基准越过int上限之后照样对；差值落在[1, maxFreq_]之外说明节点
+    //上次访问之后老化扣减的比它的频数还多(差值"为负")，折算成1
+    uint32_t freq = pool_[node].freq_ - agingBase_;
+    return freq - 1 < static_cast<uint32_t>(maxFreq_) ? static_cast<int>(freq) : 1;
 }
 template <typename Key, typename Value>
-void LfuCache<Key, Value>::addToFreqList(NodePtr node) {
-    if (node != nullptr) {
-        auto freq = freqToFreqList_.find(node->freq_);
-        if (freq == freqToFreqList_.end()) {
-            freqToFreqList_[node->freq_] = new Freqlist<Key, Value>(node->freq_);
-        }
-        freqToFreqList_[node->freq_]->addNode(node);
+Freqlist<Key, Value> &LfuCache<Key, Value>::freqList(int freq) {
+    return freqTable_[static_cast<size_t>(agingBase_ + static_cast<uint32_t>(freq)) & freqMask_];
+}
+template <typename Key, typename Value>
+void LfuCache<Key, Value>::kickOut(Slot keep) {
+    //淘汰后minFreq_所在list可能空了但紧接着会插入新节点，这里兜底向上找第一个非空list
+    while (freqList(minFreq_).isEmpty() && minFreq_ < maxFreq_) {
+        ++minFreq_;
     }
+    //找到最小频数head节点删除
+    int freq = minFreq_;
+    Slot node = freqList(freq).getFirstNode();
+    //keep是刚更新过的节点，它在所在list的尾部，只有list里只剩它时才往更高频数找
+    while (node == keep) {
+        do {
+            ++freq;
+        } while (freqList(freq).isEmpty());
+        node = freqList(freq).getFirstNode();
+    }
+    removeEntry(node);
+    stats_.record(MeltiCache::CacheStats::Counter::Evictions);
 }
 template <typename Key, typename Value>
-void LfuCache<Key, Value>::kickOut() {
-    //找到最小频数head节点后一个删除
-    auto node = freqToFreqList_[minFreq_]->getFirstNode();
-    removeFromFreqList(node);
-    nodeMap_.erase(node->key_);
+void LfuCache<Key, Value>::removeEntry(Slot node) {
+    int freq = effectiveFreq(node);
+    freqList(freq).removeNode(pool_, node);
+    nodeMap_.erase(pool_[node].hash_, node);
+    weightedSize_ -= pool_[node].weight_;
+    wheel_.deschedule(node);
     //减小平均频数
-    decreaseFreqNum(node->freq_);
+    decreaseFreqNum(freq);
+    releaseNode(node);
+}
+//淘汰时就释放value，而不是等槽位被复用；还有句柄在读的槽位不动
+template <typename Key, typename Value>
+void LfuCache<Key, Value>::releaseNode(Slot node) {
+    if (!pool_.isPinned(node))
+        pool_[node].clear();
+    pool_.release(node);
 }
 template <typename Key, typename Value>
 void LfuCache<Key, Value>::decreaseFreqNum(int num) {
@@ -226,4 +624,4 @@ void LfuCache<Key, Value>::decreaseFreqNum(int num) {
     } else {
         curAverageNum_ = curTotalNum_ / nodeMap_.size();
     }
-}
\ No newline at end of file
+}
@@ -1,5 +1,11 @@
 #pragma once
+#include "CacheStats.h"
+#include "FlatIndex.h"
 #include "ICachePolicy.h"
+#include "NodePool.h"
+#include "ShardedCache.h"
+#include "TimerWheel.h"
+#include <chrono>
 #include <cmath>
 #include <cstddef>
 #include <functional>
@@ -7,6 +13,7 @@
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include <thread>
 
@@ -19,22 +26,34 @@ class LruNode {
     Key key_;                    // 用来和map中协同找到Node的索引
     Value value_;                // value是所携带的内容
     size_t accessTimes_;         // 节点访问次数
-    std::weak_ptr<LruNode> pre_; // 前向节点使用weak防止循环引用
-    std::shared_ptr<LruNode> next_;
+    size_t weight_;              // 写入时按权重函数算出的权重
+    uint64_t hash_;              // key的哈希，删除时直接用它找索引，不用再算
+    MeltiCache::SlotIndex pre_;  // 前后节点在节点池中的槽位
+    MeltiCache::SlotIndex next_;
 
   public:
-    LruNode(Key key, Value value) : key_(key), value_(value), accessTimes_(1) {}
+    LruNode()
+        : key_(), value_(), accessTimes_(1), weight_(1), hash_(0), pre_(MeltiCache::kNullSlot),
+          next_(MeltiCache::kNullSlot) {}
 
-    Key getKey() { return key_; }
+    const Key &getKey() const { return key_; }
 
-    Value getValue() { return value_; }
+    const Value &getValue() const { return value_; }
 
     size_t getAccessCount() { return accessTimes_; }
 
     void setValue(const Value &value) { value_ = value; }
 
+    void setValue(Value &&value) { value_ = std::move(value); }
+
     void incrementAccessCount() { accessTimes_++; }
 
+    // 槽位回到池里时释放key和value持有的内存，节点对象本身留着复用
+    void clear() {
+        key_ = Key();
+        value_ = Value();
+    }
+
     friend class LruCache<Key, Value>; // LRUCache能够访问private里面的pre,next
 };
 
@@ -42,61 +61,346 @@ template <typename Key, typename Value>
 class LruCache : public MeltiCache::ICachePolicy<Key, Value> {
   private:
     using LruNodeType = LruNode<Key, Value>;
-    // 存入指针，防止移动node时候产生大量的开销，采用指针之后，只需要移动指针
-    using NodePtr = std::shared_ptr<LruNodeType>;
-    using LruMap = std::unordered_map<Key, NodePtr>;
+    // 节点统一从池里分配，map和链表里只保存槽位编号
+    using NodePool = MeltiCache::NodePool<LruNodeType>;
+    using Slot = MeltiCache::SlotIndex;
+    using LruMap = MeltiCache::FlatIndex<Key>;
 
   public:
-    LruCache(int capacity) : capacity_(capacity) { initializeList(); }
+    using Weigher = MeltiCache::Weigher<Key, Value>;
+    using Duration = MeltiCache::TimerWheel::Duration;
+
+    LruCache(int capacity) : capacity_(capacity > 0 ? capacity : 0), weightedSize_(0), pool_(capacity_ + 2) {
+        map_.reserve(capacity_);
+        initializeList();
+    }
+
+    // 按权重计容量：maxWeight是权重预算(比如字节数)，淘汰一直进行到总权重放得下为止
+    // 条目数未知，节点池和map按需增长
+    LruCache(size_t maxWeight, Weigher weigher)
+        : capacity_(maxWeight), weightedSize_(0), weigher_(std::move(weigher)), pool_(2) {
+        initializeList();
+    }
+
+    // 限定调用，不走虚函数，KLruCache覆盖了putWithHash也不会绕回来
+    void put(const Key &key, const Value &value) override { LruCache::putWithHash(key, map_.hash(key), value); }
 
-    void put(Key key, Value value) override {
-        if (capacity_ <= 0)
+    // 哈希在加锁之前算好，锁内只剩探测和链表操作
+    void putWithHash(const Key &key, uint64_t hash, const Value &value) override {
+        if (capacity_ == 0)
             return;
-        // 如果在map里找到了，更新value和把位置更新到列表最后面
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        putEntry(key, value, hash, 0);
+    }
+
+    // key和value都直接移动进池里的节点
+    void put(Key &&key, Value &&value) override {
+        uint64_t hash = map_.hash(key);
+        LruCache::putWithHash(std::move(key), hash, std::move(value));
+    }
 
-        auto it = map_.find(key);
-        if (it != map_.end()) {
-            std::lock_guard<std::mutex> lock(mutex_);
-            updateExistingNode(it->second, value);
-            // 调换位置到最后并且更新value, it->second为LruPtr,并且传入新value
+    void putWithHash(Key &&key, uint64_t hash, Value &&value) override {
+        if (capacity_ == 0)
             return;
-        }
-        // 添加节点到map和node
-        addNewNode(key, value);
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        putEntry(std::move(key), std::move(value), hash, 0);
+    }
+
+    // 单条ttl，覆盖默认的过期时间
+    void put(const Key &key, const Value &value, Duration ttl) { putWithHash(key, map_.hash(key), value, ttl); }
+
+    void put(Key &&key, Value &&value, Duration ttl) {
+        uint64_t hash = map_.hash(key);
+        putWithHash(std::move(key), hash, std::move(value), ttl);
+    }
+
+    void putWithHash(const Key &key, uint64_t hash, const Value &value, Duration ttl) {
+        if (capacity_ == 0)
+            return;
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        expiring_ = true;
+        putEntry(key, value, hash, toNanos(ttl));
+    }
+
+    void putWithHash(Key &&key, uint64_t hash, Value &&value, Duration ttl) {
+        if (capacity_ == 0)
+            return;
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        expiring_ = true;
+        putEntry(std::move(key), std::move(value), hash, toNanos(ttl));
     }
 
-    bool get(Key key, Value &value) override {
-        auto it = map_.find(key);
-        if (it != map_.end()) {
-            std::lock_guard<std::mutex> lock(mutex_);
-            moveToMostRecent(it->second);
-            value = it->second->getValue();
+    // 写入ttl之后过期；设置过过期时间之后，每次读写都要读一次时钟
+    void setExpireAfterWrite(Duration ttl) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        expireAfterWrite_ = toNanos(ttl);
+        expiring_ = true;
+    }
+
+    // ttl内没有被读写就过期，每次访问都会把过期时间顺延
+    void setExpireAfterAccess(Duration ttl) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        expireAfterAccess_ = toNanos(ttl);
+        expiring_ = true;
+    }
+
+    // 推进时间轮，把所有到期的条目一次性回收；写入时也会顺带做一次
+    void cleanUp() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (expiring_)
+            expireEntries(MeltiCache::TimerWheel::now());
+    }
+
+    bool insertIfAbsent(const Key &key, const std::function<Value()> &makeValue) override {
+        return LruCache::insertIfAbsentWithHash(key, map_.hash(key), makeValue);
+    }
+
+    bool insertIfAbsentWithHash(const Key &key, uint64_t hash, const std::function<Value()> &makeValue) override {
+        if (capacity_ == 0)
+            return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t now = expiring_ ? MeltiCache::TimerWheel::now() : 0;
+        Slot slot = findSlot(key, hash);
+        if (slot != MeltiCache::kNullSlot && (!expiring_ || !wheel_.expired(slot, now)))
+            return false;
+        putEntry(key, makeValue(), hash, 0, now);
+        return true;
+    }
+
+    bool contains(const Key &key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return findSlot(key) != MeltiCache::kNullSlot;
+    }
+
+    // 删除key，返回是否存在
+    bool remove(const Key &key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot slot = findSlot(key);
+        if (slot == MeltiCache::kNullSlot)
+            return false;
+        removeEntry(slot);
+        return true;
+    }
+
+    size_t weightedSize() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return weightedSize_;
+    }
+
+    bool get(const Key &key, Value &value) override { return LruCache::getWithHash(key, map_.hash(key), value); }
+
+    bool getWithHash(const Key &key, uint64_t hash, Value &value) override {
+        MeltiCache::CacheStats::Timer timer(stats_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot slot = findSlot(key, hash);
+        if (slot != MeltiCache::kNullSlot && (!expiring_ || touchExpiry(slot, MeltiCache::TimerWheel::now()))) {
+            moveToMostRecent(slot);
+            value = pool_[slot].value_;
+            stats_.record(MeltiCache::CacheStats::Counter::Hits);
             return true;
         }
+        stats_.record(MeltiCache::CacheStats::Counter::Misses);
         return false;
     }
 
-    Value get(Key key) override {
+    Value get(const Key &key) override {
         Value value{};
         get(key, value);
         return value;
     }
 
+    // 命中时直接指向池里的节点，不拷贝value
+    MeltiCache::ValueHandle<Value> getHandle(const Key &key) override {
+        return LruCache::getHandleWithHash(key, map_.hash(key));
+    }
+
+    MeltiCache::ValueHandle<Value> getHandleWithHash(const Key &key, uint64_t hash) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot slot = findSlot(key, hash);
+        if (slot == MeltiCache::kNullSlot || (expiring_ && !touchExpiry(slot, MeltiCache::TimerWheel::now()))) {
+            stats_.record(MeltiCache::CacheStats::Counter::Misses);
+            return MeltiCache::ValueHandle<Value>();
+        }
+        stats_.record(MeltiCache::CacheStats::Counter::Hits);
+        moveToMostRecent(slot);
+        return MeltiCache::ValueHandle<Value>(&pool_[slot].value_, &pool_.pins(slot));
+    }
+
+    // 整批只加一次锁，哈希由调用方在锁外算好：先把所有key查一遍并预取节点，再统一读值、调整顺序
+    size_t getManyWithHash(const std::vector<Key> &keys, const std::vector<uint64_t> &hashes,
+                           MeltiCache::BatchRange range, std::vector<Value> &values,
+                           std::vector<bool> &found) override {
+        std::vector<Slot> slots(range.size(), MeltiCache::kNullSlot);
+        size_t hits = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t now = expiring_ ? MeltiCache::TimerWheel::now() : 0;
+        for (size_t i = range.begin; i < range.end; ++i) {
+            size_t at = range[i];
+            Slot slot = findSlot(keys[at], hashes[at]);
+            // 过期的条目在这一遍就删掉，批里重复出现的同一个key后面就查不到了
+            if (slot != MeltiCache::kNullSlot && (!expiring_ || touchExpiry(slot, now))) {
+                slots[i - range.begin] = slot;
+                pool_.prefetch(slot);
+            }
+        }
+        for (size_t i = range.begin; i < range.end; ++i) {
+            Slot slot = slots[i - range.begin];
+            if (slot == MeltiCache::kNullSlot)
+                continue;
+            moveToMostRecent(slot);
+            values[range[i]] = pool_[slot].value_;
+            found[range[i]] = true;
+            ++hits;
+        }
+        stats_.record(MeltiCache::CacheStats::Counter::Hits, hits);
+        stats_.record(MeltiCache::CacheStats::Counter::Misses, range.size() - hits);
+        return hits;
+    }
+
+    void putManyWithHash(const std::vector<Key> &keys, const std::vector<uint64_t> &hashes,
+                         const std::vector<Value> &values, MeltiCache::BatchRange range) override {
+        if (capacity_ == 0)
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t now = expiring_ ? MeltiCache::TimerWheel::now() : 0;
+        for (size_t i = range.begin; i < range.end; ++i) {
+            size_t at = range[i];
+            putEntry(keys[at], values[at], hashes[at], 0, now);
+        }
+    }
+
+    // 命中/未命中/写入/淘汰/过期计数，开了采样时还有延迟直方图；计数不加锁读
+    MeltiCache::CacheStatsSnapshot stats() {
+        MeltiCache::CacheStatsSnapshot snapshot;
+        stats_.fill(snapshot);
+        return snapshot;
+    }
+
+    // 每个线程每period次读写计时一次，0为关闭
+    void setLatencySampling(uint32_t period) { stats_.setLatencySampling(period); }
+
   private:
+    // 在索引里查key所在的槽位，没有时返回kNullSlot；比较key时直接读池里的节点
+    Slot findSlot(const Key &key, uint64_t hash) const {
+        return map_.find(hash, [&](Slot slot) { return pool_[slot].key_ == key; });
+    }
+
+    Slot findSlot(const Key &key) const { return findSlot(key, map_.hash(key)); }
+
+    static uint64_t toNanos(Duration ttl) { return ttl.count() > 0 ? static_cast<uint64_t>(ttl.count()) : 0; }
+
+    // 调用方已持有锁。开了过期时先回收到期条目，再写入并挂上新的过期时间；ttl为0时用默认的
+    // hash是key的哈希，now由批量调用方传入，整批只读一次时钟
+    template <typename K, typename V>
+    void putEntry(K &&key, V &&value, uint64_t hash, uint64_t ttl, uint64_t now = 0) {
+        stats_.record(MeltiCache::CacheStats::Counter::Puts);
+        if (!expiring_) {
+            putImpl(std::forward<K>(key), std::forward<V>(value), hash);
+            return;
+        }
+        if (now == 0)
+            now = MeltiCache::TimerWheel::now();
+        expireEntries(now);
+        Slot node = putImpl(std::forward<K>(key), std::forward<V>(value), hash);
+        if (node == MeltiCache::kNullSlot)
+            return;
+        if (ttl == 0)
+            ttl = expireAfterWrite_ ? expireAfterWrite_ : expireAfterAccess_;
+        wheel_.schedule(node, ttl ? now + ttl : 0);
+    }
+
+    // 命中后检查过期：已经到期的当作未命中并删掉；只配了expire-after-access时顺延过期时间
+    bool touchExpiry(Slot node, uint64_t now) {
+        if (wheel_.expired(node, now)) {
+            removeEntry(node);
+            stats_.record(MeltiCache::CacheStats::Counter::Expirations);
+            return false;
+        }
+        if (expireAfterAccess_ && !expireAfterWrite_ && wheel_.deadlineOf(node))
+            wheel_.schedule(node, now + expireAfterAccess_);
+        return true;
+    }
+
+    void expireEntries(uint64_t now) {
+        size_t expired = 0;
+        wheel_.advance(now, [this, &expired](Slot node) {
+            removeEntry(node);
+            ++expired;
+        });
+        if (expired)
+            stats_.record(MeltiCache::CacheStats::Counter::Expirations, expired);
+    }
+
+    // 调用方已持有锁；K/V是转发引用，右值一路移动到节点里；返回写入的节点，没有缓存时返回kNullSlot
+    template <typename K, typename V>
+    Slot putImpl(K &&key, V &&value, uint64_t hash) {
+        // 如果在map里找到了，更新value和把位置更新到列表最后面
+        Slot slot = findSlot(key, hash);
+        if (slot != MeltiCache::kNullSlot) {
+            // 调换位置到最后并且更新value, 传入节点槽位和新value
+            return updateExistingNode(slot, std::forward<V>(value));
+        }
+        // 添加节点到map和node
+        return addNewNode(std::forward<K>(key), std::forward<V>(value), hash);
+    }
+
     void initializeList() {
-        dummyHead_ = std::make_shared<LruNodeType>(Key(), Value());
-        // Key(),Value()写法：告诉编译器Key和Value的默认值
-        dummyTail_ = std::make_shared<LruNodeType>(Key(), Value());
-        dummyHead_->next_ = dummyTail_;
-        dummyTail_->pre_ = dummyHead_;
+        // 头尾哨兵也放在池里，Key(),Value()为默认值
+        dummyHead_ = pool_.allocate();
+        dummyTail_ = pool_.allocate();
+        pool_[dummyHead_].next_ = dummyTail_;
+        pool_[dummyTail_].pre_ = dummyHead_;
     }
 
-    void updateExistingNode(NodePtr node, Value &value) {
-        node->setValue(value);
+    template <typename V>
+    Slot updateExistingNode(Slot node, V &&value) {
+        size_t weight = MeltiCache::weightOf(weigher_, pool_[node].key_, static_cast<const Value &>(value));
+        if (weight > capacity_) {
+            // 新值单独就超过预算，直接删掉这个key
+            removeEntry(node);
+            return MeltiCache::kNullSlot;
+        }
+        // 旧值还被句柄引用时不能原地覆盖，换一个新节点顶替它的位置
+        if (pool_.isPinned(node))
+            node = replacePinnedNode(node);
+        pool_[node].setValue(std::forward<V>(value));
+        weightedSize_ = weightedSize_ - pool_[node].weight_ + weight;
+        pool_[node].weight_ = weight;
         moveToMostRecent(node);
+        // 变重之后可能超出预算，从最久未访问的一端淘汰，刚更新的节点在最新端不会被淘汰
+        while (weightedSize_ > capacity_)
+            evictLeastRecent();
+        return node;
     }
 
-    void moveToMostRecent(NodePtr node) {
+    Slot replacePinnedNode(Slot old) {
+        Slot node = pool_.allocate();
+        LruNodeType &cur = pool_[node];
+        LruNodeType &prev = pool_[old];
+        cur.key_ = prev.key_;
+        cur.accessTimes_ = prev.accessTimes_;
+        cur.weight_ = prev.weight_;
+        cur.hash_ = prev.hash_;
+        cur.pre_ = prev.pre_;
+        cur.next_ = prev.next_;
+        pool_[cur.pre_].next_ = node;
+        pool_[cur.next_].pre_ = node;
+        prev.pre_ = MeltiCache::kNullSlot;
+        prev.next_ = MeltiCache::kNullSlot;
+        map_.replace(cur.hash_, old, node);
+        // 过期时间跟着搬到新节点上
+        uint64_t deadline = wheel_.deadlineOf(old);
+        wheel_.deschedule(old);
+        wheel_.schedule(node, deadline);
+        releaseNode(old);
+        return node;
+    }
+
+    void moveToMostRecent(Slot node) {
         // 删除当前位置
         removeNode(node);
 
@@ -104,98 +408,131 @@ class LruCache : public MeltiCache::ICachePolicy<Key, Value> {
         insertNode(node);
     }
 
-    void removeNode(NodePtr node) {
-
-        auto preNode = node->pre_.lock();
-        if (preNode && node->next_) {
-            preNode->next_ = node->next_;
-            node->next_->pre_ = preNode;
-            node->pre_.reset();
-            node->next_ = nullptr;
+    void removeNode(Slot node) {
+        LruNodeType &cur = pool_[node];
+        if (cur.pre_ != MeltiCache::kNullSlot && cur.next_ != MeltiCache::kNullSlot) {
+            pool_[cur.pre_].next_ = cur.next_;
+            pool_[cur.next_].pre_ = cur.pre_;
+            cur.pre_ = MeltiCache::kNullSlot;
+            cur.next_ = MeltiCache::kNullSlot;
         }
     }
 
-    void insertNode(NodePtr node) {
-
-        node->pre_ = dummyTail_->pre_.lock();
-        node->next_ = dummyTail_;
-        dummyTail_->pre_.lock()->next_ = node;
-        dummyTail_->pre_ = node;
+    void insertNode(Slot node) {
+        LruNodeType &cur = pool_[node];
+        LruNodeType &tail = pool_[dummyTail_];
+        cur.pre_ = tail.pre_;
+        cur.next_ = dummyTail_;
+        pool_[tail.pre_].next_ = node;
+        tail.pre_ = node;
     }
 
-    void addNewNode(Key &key, Value &value) {
-        // 如果map长度比容量大或者等于，那么就要把最久没访问的删掉
-        if (map_.size() >= capacity_) {
+    template <typename K, typename V>
+    Slot addNewNode(K &&key, V &&value, uint64_t hash) {
+        size_t weight = MeltiCache::weightOf(weigher_, static_cast<const Key &>(key), static_cast<const Value &>(value));
+        if (weight > capacity_)
+            return MeltiCache::kNullSlot; // 单个条目就超过预算，不缓存
+        // 总权重放不下新节点，就一直把最久没访问的删掉
+        while (weightedSize_ + weight > capacity_) {
             evictLeastRecent();
         }
-        NodePtr newnode = std::make_shared<LruNodeType>(key, value);
+        // 被淘汰的槽位会在这里直接复用，稳定状态下不再申请内存
+        Slot newnode = pool_.allocate();
+        LruNodeType &node = pool_[newnode];
+        // 索引里只记槽位，key只在节点里存一份
+        map_.insert(hash, newnode);
+        node.key_ = std::forward<K>(key);
+        node.hash_ = hash;
+        node.value_ = std::forward<V>(value);
+        node.accessTimes_ = 1;
+        node.weight_ = weight;
+        weightedSize_ += weight;
         insertNode(newnode);
-        map_[key] = newnode;
+        return newnode;
     }
 
     void evictLeastRecent() {
-        auto node = dummyHead_->next_;
+        removeEntry(pool_[dummyHead_].next_);
+        stats_.record(MeltiCache::CacheStats::Counter::Evictions);
+    }
+
+    // 从链表、map和时间轮里摘掉节点并回收
+    void removeEntry(Slot node) {
         removeNode(node);
-        map_.erase(node->getKey());
+        map_.erase(pool_[node].hash_, node);
+        weightedSize_ -= pool_[node].weight_;
+        wheel_.deschedule(node);
+        releaseNode(node);
+    }
+
+    // 淘汰时就释放value，而不是等槽位被复用；还有句柄在读的槽位不动
+    void releaseNode(Slot node) {
+        if (!pool_.isPinned(node))
+            pool_[node].clear();
+        pool_.release(node);
     }
 
   private:
-    NodePtr dummyHead_;
-    NodePtr dummyTail_;
-    size_t capacity_; // 要创建Cache的容量
+    size_t capacity_; // 要创建Cache的容量，配了权重函数时是权重预算
+    size_t weightedSize_; // 当前总权重
+    Weigher weigher_;
+    uint64_t expireAfterWrite_ = 0;  // 默认写入后过期时间，ns，0表示不过期
+    uint64_t expireAfterAccess_ = 0; // 默认访问后过期时间，ns
+    bool expiring_ = false;          // 有没有条目可能过期，没有时读写都不碰时钟
+    MeltiCache::TimerWheel wheel_;
+    NodePool pool_;
+    Slot dummyHead_;
+    Slot dummyTail_;
     LruMap map_;
     std::mutex mutex_;
+    MeltiCache::CacheStats stats_;
 };
 template <typename Key, typename Value>
-class KLruCache : LruCache<Key, Value> {
+class KLruCache : public LruCache<Key, Value> {
   public:
     KLruCache(int capacity, int historyCapacity, int k)
         : LruCache<Key, Value>(capacity), // 构造基类LruCache用作主缓存
-          historyList_(std::make_unique<LruCache<Key, size_t>>(historyCapacity)),
-          k_(k) {}
-
-    void put(Key key, Value value) override {
-        //查看主缓存里是否含有key
-        bool mainMachine = LruCache<Key, Value>::get(key);
-        //如果有则直接调用基类put
-        if (mainMachine) {
-            LruCache<Key, Value>::put(key, value);
-        }
-        //历史列表里更新访问次数
-        size_t accessCount_ = historyList_.get(key);
-        //get算访问一次，访问次数++
-        accessCount_++;
-        //再把更新次数的key,更新historyList
-        historyList_.put(key, accessCount_);
-        //map也要更新方便把到达阈值的key放入主缓存
-        historyValueMap_[key] = value;
+          k_(k),
+          historyList_(std::make_unique<LruCache<Key, size_t>>(historyCapacity)) {}
 
-        if (accessCount_ >= k_) {
-            LruCache<Key, Value>::put(key, value);
-            historyList_.remove(key);
-            historyValueMap_.erase(key);
-        }
+    using LruCache<Key, Value>::get;
+
+    void put(const Key &key, const Value &value) override { admit(key, value); }
+
+    void put(Key &&key, Value &&value) override { admit(std::move(key), std::move(value)); }
+
+    // 准入只看访问次数，预先算好的哈希用不上
+    void putWithHash(const Key &key, uint64_t, const Value &value) override { admit(key, value); }
+
+    void putWithHash(Key &&key, uint64_t, Value &&value) override { admit(std::move(key), std::move(value)); }
+
+    // 批量写也要过准入
+    void putManyWithHash(const std::vector<Key> &keys, const std::vector<uint64_t> &,
+                         const std::vector<Value> &values, MeltiCache::BatchRange range) override {
+        for (size_t i = range.begin; i < range.end; ++i)
+            admit(keys[range[i]], values[range[i]]);
     }
 
-    Value get(Key key) override {
+    Value get(const Key &key) override {
         Value value{};
         bool mainMachine = LruCache<Key, Value>::get(key, value);
 
-        size_t accessCount = historyList_.get(key);
+        size_t accessCount = historyList_->get(key);
         accessCount++;
-        historyList_.put(key, accessCount);
+        historyList_->put(key, accessCount);
 
         if(mainMachine) return value;
 
-        if (accessCount >= k_) {
+        std::lock_guard<std::mutex> lock(historyMutex_);
+        if (accessCount >= static_cast<size_t>(k_)) {
             auto it = historyValueMap_.find(key);
             if(it != historyValueMap_.end())
             {
 
-              Value storedValue = it->second;
-              LruCache<Key,  Value>::put(key,storedValue);
-              historyList_.remove(key);
+              Value storedValue = std::move(it->second);
               historyValueMap_.erase(it);
+              historyList_->remove(key);
+              LruCache<Key,  Value>::put(key, storedValue);
               return storedValue;
             }
         }
@@ -203,55 +540,41 @@ class KLruCache : LruCache<Key, Value> {
       
     }
 
+  private:
+    template <typename K, typename V>
+    void admit(K &&key, V &&value) {
+        std::lock_guard<std::mutex> lock(historyMutex_);
+        //主缓存里已有则直接更新
+        if (LruCache<Key, Value>::contains(key)) {
+            LruCache<Key, Value>::put(std::forward<K>(key), std::forward<V>(value));
+            return;
+        }
+        //历史列表里更新访问次数，put算访问一次
+        size_t accessCount = historyList_->get(key) + 1;
+        if (accessCount >= static_cast<size_t>(k_)) {
+            //到达阈值，value直接移动进主缓存
+            historyList_->remove(key);
+            historyValueMap_.erase(key);
+            LruCache<Key, Value>::put(std::forward<K>(key), std::forward<V>(value));
+            return;
+        }
+        historyList_->put(key, accessCount);
+        //map也要更新方便把到达阈值的key放入主缓存
+        historyValueMap_[std::forward<K>(key)] = std::forward<V>(value);
+    }
+
   private:
     int k_; // 达到k次放入主缓存
     // 历史访问列表,Key和访问次数
     std::unique_ptr<LruCache<Key, size_t>> historyList_;
-    std::unordered_map<Key, Value> historyValueMap_; // 未达到访问K次的数据未达到访问K次的数据未达到访问K次的数据
+    std::unordered_map<Key, Value> historyValueMap_; // 未达到访问K次的数据
+    std::mutex historyMutex_; // 保护historyValueMap_, 主缓存和历史列表各有自己的锁
+};
+// 分片LRU缓存：每个分片是独立的LruCache，各自持有锁，降低锁竞争
+template <typename Key, typename Value>
+class HashLruCache : public ShardedCache<Key, Value, LruCache<Key, Value>> {
+  public:
+    // slicedNumber为0时按CPU核数分片
+    HashLruCache(int cacheCapacity, int slicedNumber)
+        : ShardedCache<Key, Value, LruCache<Key, Value>>(cacheCapacity, slicedNumber) {}
 };
-template<typename Key,typename Value>
-class HashLruCache:public LruCache< Key,  Value>
-{
-
-    private:
-    //采用vector管理分片缓存
-    std::vector<std::unique_ptr<LruCache< Key,  Value>>> slicedCache_;
-    int slicedNumber_;    //切片数量
-    int cacheCapacity_;   //总缓存容量
-
-    public:
-    HashLruCache< Key,  Value>(int cacheCapacity,int slicedNumber):
-    cacheCapacity_(cacheCapacity),
-    slicedCache_(slicedNumber?slicedNumber:std::thread::hardware_concurrency())
-    {
-        int slicedCapacity = std::ceil(cacheCapacity/static_cast<double>(slicedNumber_));//获取每个分片应该的容量
-        for(int i =0; i<slicedNumber_;i++)
-        {
-            slicedCache_.emplace_back(LruCache< Key,  Value>(slicedCapacity));//分片缓存存入vector进行管理
-        }
-    }
-    void put(Key key,Value value) override
-    {
-        size_t slicedIndex = Hash(key)% slicedNumber_;//计算索引，放入哪一个分片中
-        slicedCache_[slicedIndex]->put(key,value);
-    }
-    bool get(Key key,Value &value) override
-    {
-         size_t slicedIndex = Hash(key)% slicedNumber_;//计算索引，在哪一个分片中
-         return slicedCache_[slicedIndex]->get(key,value);
-    }
-    Value get(Key key) override
-    {
-        Value value{};
-        get(key,value);
-        return value;
-
-    }
-
-    private:
-    size_t Hash(Key key)
-    {
-        std::hash<Key> hashFunc;
-        return hashFunc(key);
-    }
-};
\ No newline at end of file
@@ -0,0 +1,378 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+#include "FlatIndex.h"
+#include "ICachePolicy.h"
+#include "NodePool.h"
+#include "ReadBuffer.h"
+
+// LIRS (Jiang & Zhang, SIGMETRICS 2002): entries are ranked by inter-reference recency, the number of other
+// keys touched between their last two accesses, instead of by recency alone. Keys with a short IRR are LIR and
+// always resident; the rest are HIR and share a small resident budget (hirRatio of the capacity, 1% by
+// default) in a FIFO queue. The LIRS stack orders LIR keys, resident HIR keys and non-resident HIR keys (key
+// only, no value) by recency and is pruned so its bottom is always a LIR key. A HIR key accessed again while
+// it is still in the stack has a shorter IRR than the oldest LIR key and swaps places with it. A loop
+// slightly larger than the cache therefore keeps most of its keys resident, where LRU hits nothing.
+// Non-resident keys are capped at the capacity, the oldest are forgotten first, so the metadata is bounded
+// by twice the capacity in nodes.
+// Hits run under the shared lock and are buffered like ArcCache's; the stack moves are replayed in a batch
+// by the next writer.
+template <typename Key, typename Value>
+class LirsCache : public MeltiCache::ICachePolicy<Key, Value>
+{
+  private:
+    enum class State : uint8_t
+    {
+        Lir,
+        ResidentHir,
+        NonResidentHir
+    };
+
+    struct Node
+    {
+        Key key_;
+        Value value_;
+        uint64_t hash_ = 0;
+        State state_ = State::Lir;
+        bool inStack_ = false;
+        uint32_t stamp_ = 0;  // bumped whenever the node stops being resident, so stale buffered hits are ignored
+        MeltiCache::SlotIndex stackPrev_ = MeltiCache::kNullSlot;
+        MeltiCache::SlotIndex stackNext_ = MeltiCache::kNullSlot;
+        // the HIR queue for resident HIR nodes, the list of non-resident nodes for the others
+        MeltiCache::SlotIndex queuePrev_ = MeltiCache::kNullSlot;
+        MeltiCache::SlotIndex queueNext_ = MeltiCache::kNullSlot;
+    };
+
+    using NodePool = MeltiCache::NodePool<Node>;
+    using Slot = MeltiCache::SlotIndex;
+
+  public:
+    explicit LirsCache(int capacity, double hirRatio = 0.01)
+        : capacity_(capacity > 0 ? capacity : 0),
+          hirCapacity_(capacity_ > 1 ? std::min(capacity_ - 1,
+                                                std::max<size_t>(1, static_cast<size_t>(capacity_ * hirRatio)))
+                                     : capacity_),
+          lirCapacity_(capacity_ - hirCapacity_),
+          lirCount_(0),
+          residentCount_(0),
+          nonResidentCount_(0),
+          pool_(2 * capacity_ + 3)
+    {
+        map_.reserve(2 * capacity_);
+        stack_ = makeSentinel();
+        queue_ = makeSentinel();
+        nonResident_ = makeSentinel();
+    }
+
+    void put(const Key& key, const Value& value) override { LirsCache::putWithHash(key, map_.hash(key), value); }
+
+    void putWithHash(const Key& key, uint64_t hash, const Value& value) override
+    {
+        if (capacity_ == 0) return;
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        drainReadBuffer();
+        putImpl(key, value, hash);
+    }
+
+    void put(Key&& key, Value&& value) override
+    {
+        uint64_t hash = map_.hash(key);
+        LirsCache::putWithHash(std::move(key), hash, std::move(value));
+    }
+
+    void putWithHash(Key&& key, uint64_t hash, Value&& value) override
+    {
+        if (capacity_ == 0) return;
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        drainReadBuffer();
+        putImpl(std::move(key), std::move(value), hash);
+    }
+
+    // non-resident keys count as absent, inserting one brings it back as LIR like a put
+    bool insertIfAbsent(const Key& key, const std::function<Value()>& makeValue) override
+    {
+        return LirsCache::insertIfAbsentWithHash(key, map_.hash(key), makeValue);
+    }
+
+    bool insertIfAbsentWithHash(const Key& key, uint64_t hash, const std::function<Value()>& makeValue) override
+    {
+        if (capacity_ == 0) return false;
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        drainReadBuffer();
+        Slot slot = findSlot(key, hash);
+        if (slot != MeltiCache::kNullSlot && pool_[slot].state_ != State::NonResidentHir) return false;
+        putImpl(key, makeValue(), hash);
+        return true;
+    }
+
+    bool get(const Key& key, Value& value) override { return LirsCache::getWithHash(key, map_.hash(key), value); }
+
+    bool getWithHash(const Key& key, uint64_t hash, Value& value) override
+    {
+        bool needDrain = false;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            Slot slot = findSlot(key, hash);
+            if (slot == MeltiCache::kNullSlot || pool_[slot].state_ == State::NonResidentHir) return false;
+            value = pool_[slot].value_;
+            needDrain = !readBuffer_.record((static_cast<uint64_t>(pool_[slot].stamp_) << 32) | slot);
+        }
+        if (needDrain)
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_, std::try_to_lock);
+            if (lock.owns_lock())
+            {
+                drainReadBuffer();
+            }
+        }
+        return true;
+    }
+
+    Value get(const Key& key) override
+    {
+        Value value{};
+        get(key, value);
+        return value;
+    }
+
+    // resident entries, LIRS has no weigher
+    size_t weightedSize() override
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return residentCount_;
+    }
+
+  private:
+    Slot makeSentinel()
+    {
+        Slot slot = pool_.allocate();
+        pool_[slot].stackPrev_ = pool_[slot].stackNext_ = slot;
+        pool_[slot].queuePrev_ = pool_[slot].queueNext_ = slot;
+        return slot;
+    }
+
+    Slot findSlot(const Key& key, uint64_t hash) const
+    {
+        return map_.find(hash, [&](Slot slot) { return pool_[slot].key_ == key; });
+    }
+
+    template <typename K, typename V>
+    void putImpl(K&& key, V&& value, uint64_t hash)
+    {
+        Slot slot = findSlot(key, hash);
+        if (slot != MeltiCache::kNullSlot && pool_[slot].state_ != State::NonResidentHir)
+        {
+            pool_[slot].value_ = std::forward<V>(value);
+            access(slot);
+            return;
+        }
+        if (residentCount_ == capacity_) evictHir();
+        ++residentCount_;
+        if (slot != MeltiCache::kNullSlot)
+        {
+            // a non-resident key back within its IRR: it beats the oldest LIR key
+            Node& node = pool_[slot];
+            unlinkQueue(slot);
+            --nonResidentCount_;
+            node.value_ = std::forward<V>(value);
+            node.state_ = State::Lir;
+            ++lirCount_;
+            unlinkStack(slot);
+            pushStack(slot);
+            balanceLir();
+            return;
+        }
+        slot = pool_.allocate();
+        Node& node = pool_[slot];
+        node.key_ = std::forward<K>(key);
+        node.value_ = std::forward<V>(value);
+        node.hash_ = hash;
+        map_.insert(hash, slot);
+        pushStack(slot);
+        if (lirCount_ < lirCapacity_)
+        {
+            // warm-up: the first keys fill the LIR set
+            node.state_ = State::Lir;
+            ++lirCount_;
+        }
+        else
+        {
+            node.state_ = State::ResidentHir;
+            pushQueue(queue_, slot);
+        }
+        trimNonResident();
+    }
+
+    // a hit on a resident node, caller holds the exclusive lock
+    void access(Slot slot)
+    {
+        Node& node = pool_[slot];
+        if (node.state_ == State::Lir)
+        {
+            bool bottom = pool_[stack_].stackPrev_ == slot;
+            unlinkStack(slot);
+            pushStack(slot);
+            if (bottom) prune();
+            return;
+        }
+        unlinkQueue(slot);
+        if (node.inStack_)
+        {
+            node.state_ = State::Lir;
+            ++lirCount_;
+            unlinkStack(slot);
+            pushStack(slot);
+            balanceLir();
+            return;
+        }
+        // not in the stack: its IRR is unknown, it stays HIR for another round of the queue
+        pushStack(slot);
+        pushQueue(queue_, slot);
+    }
+
+    // demotes the oldest LIR keys to HIR while the LIR set is over budget
+    void balanceLir()
+    {
+        while (lirCount_ > lirCapacity_)
+        {
+            prune();
+            Slot bottom = pool_[stack_].stackPrev_;
+            unlinkStack(bottom);
+            pool_[bottom].state_ = State::ResidentHir;
+            --lirCount_;
+            pushQueue(queue_, bottom);
+        }
+        prune();
+        trimNonResident();
+    }
+
+    // pops HIR entries off the stack bottom until a LIR key is there; non-resident ones are forgotten
+    void prune()
+    {
+        for (Slot bottom = pool_[stack_].stackPrev_; bottom != stack_ && pool_[bottom].state_ != State::Lir;
+             bottom = pool_[stack_].stackPrev_)
+        {
+            unlinkStack(bottom);
+            if (pool_[bottom].state_ == State::NonResidentHir) forget(bottom);
+        }
+    }
+
+    // evicts the front of the HIR queue; it stays in the stack as a non-resident key if it is still there
+    void evictHir()
+    {
+        Slot victim = pool_[queue_].queueNext_;
+        if (victim == queue_) return;
+        Node& node = pool_[victim];
+        unlinkQueue(victim);
+        --residentCount_;
+        ++node.stamp_;
+        if (!node.inStack_)
+        {
+            forget(victim);
+            return;
+        }
+        node.state_ = State::NonResidentHir;
+        node.value_ = Value();
+        pushQueue(nonResident_, victim);
+        ++nonResidentCount_;
+    }
+
+    // bounds the metadata: the oldest non-resident keys leave the stack first
+    void trimNonResident()
+    {
+        while (nonResidentCount_ > capacity_)
+        {
+            Slot oldest = pool_[nonResident_].queueNext_;
+            unlinkStack(oldest);
+            forget(oldest);
+        }
+    }
+
+    // drops a node that is not resident or is being evicted outside the stack
+    void forget(Slot slot)
+    {
+        Node& node = pool_[slot];
+        if (node.state_ == State::NonResidentHir)
+        {
+            unlinkQueue(slot);
+            --nonResidentCount_;
+        }
+        map_.erase(node.hash_, slot);
+        ++node.stamp_;
+        node.key_ = Key();
+        node.value_ = Value();
+        node.inStack_ = false;
+        pool_.release(slot);
+    }
+
+    void pushStack(Slot slot)
+    {
+        Node& node = pool_[slot];
+        node.stackPrev_ = stack_;
+        node.stackNext_ = pool_[stack_].stackNext_;
+        pool_[node.stackNext_].stackPrev_ = slot;
+        pool_[stack_].stackNext_ = slot;
+        node.inStack_ = true;
+    }
+
+    void unlinkStack(Slot slot)
+    {
+        Node& node = pool_[slot];
+        if (!node.inStack_) return;
+        pool_[node.stackPrev_].stackNext_ = node.stackNext_;
+        pool_[node.stackNext_].stackPrev_ = node.stackPrev_;
+        node.inStack_ = false;
+    }
+
+    // appends at the back of a queue-linked list (the HIR queue or the non-resident list)
+    void pushQueue(Slot list, Slot slot)
+    {
+        Node& node = pool_[slot];
+        node.queueNext_ = list;
+        node.queuePrev_ = pool_[list].queuePrev_;
+        pool_[node.queuePrev_].queueNext_ = slot;
+        pool_[list].queuePrev_ = slot;
+    }
+
+    void unlinkQueue(Slot slot)
+    {
+        Node& node = pool_[slot];
+        if (node.queueNext_ == MeltiCache::kNullSlot) return;
+        pool_[node.queuePrev_].queueNext_ = node.queueNext_;
+        pool_[node.queueNext_].queuePrev_ = node.queuePrev_;
+        node.queuePrev_ = node.queueNext_ = MeltiCache::kNullSlot;
+    }
+
+    // replays buffered hits, caller holds the exclusive lock
+    void drainReadBuffer()
+    {
+        readBuffer_.drain(
+            [this](uint64_t entry)
+            {
+                Slot slot = static_cast<Slot>(entry);
+                uint32_t stamp = static_cast<uint32_t>(entry >> 32);
+                if (pool_[slot].stamp_ == stamp && pool_[slot].state_ != State::NonResidentHir) access(slot);
+            });
+    }
+
+  private:
+    size_t capacity_;     // resident entries
+    size_t hirCapacity_;  // resident HIR budget, the rest of the capacity is for LIR keys
+    size_t lirCapacity_;
+    size_t lirCount_;
+    size_t residentCount_;
+    size_t nonResidentCount_;  // at most capacity_
+    NodePool pool_;
+    Slot stack_;        // sentinel of the LIRS stack, top at stackNext_
+    Slot queue_;        // sentinel of the resident HIR queue, front (next victim) at queueNext_
+    Slot nonResident_;  // sentinel of the non-resident keys, oldest at queueNext_
+    MeltiCache::FlatIndex<Key> map_;
+    std::shared_mutex mutex_;
+    MeltiCache::ReadBuffer readBuffer_;
+};
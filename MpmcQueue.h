@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace MeltiCache
+{
+    // Bounded multi-producer multi-consumer ring (Vyukov): every cell carries a sequence number that tells
+    // producers and consumers whose turn it is, so tryPush and tryPop each cost one CAS on the shared
+    // position and never block or allocate. The capacity is rounded up to a power of two. tryPush fails
+    // when the ring is full and tryPop when it is empty; neither waits for the other side.
+    template <typename T>
+    class MpmcQueue
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "MpmcQueue holds trivially copyable values");
+
+      public:
+        explicit MpmcQueue(size_t capacity) : mask_(roundUp(capacity) - 1), cells_(new Cell[mask_ + 1])
+        {
+            for (size_t i = 0; i <= mask_; ++i)
+            {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            enqueue_.store(0, std::memory_order_relaxed);
+            dequeue_.store(0, std::memory_order_relaxed);
+        }
+
+        MpmcQueue(const MpmcQueue &) = delete;
+        MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+        bool tryPush(const T &value)
+        {
+            size_t pos = enqueue_.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell &cell = cells_[pos & mask_];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+                if (diff == 0)
+                {
+                    if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell.value = value;
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;  // the cell still holds a value from the previous lap: full
+                }
+                else
+                {
+                    pos = enqueue_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool tryPop(T &value)
+        {
+            size_t pos = dequeue_.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell &cell = cells_[pos & mask_];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (dequeue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        value = cell.value;
+                        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;  // nothing published in this cell yet: empty
+                }
+                else
+                {
+                    pos = dequeue_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        size_t capacity() const { return mask_ + 1; }
+
+        // exact only while no push or pop is in flight
+        size_t sizeApprox() const
+        {
+            size_t dequeue = dequeue_.load(std::memory_order_relaxed);
+            size_t enqueue = enqueue_.load(std::memory_order_relaxed);
+            return enqueue > dequeue ? enqueue - dequeue : 0;
+        }
+
+      private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        static size_t roundUp(size_t capacity)
+        {
+            size_t size = 2;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+            return size;
+        }
+
+        size_t mask_;
+        std::unique_ptr<Cell[]> cells_;
+        // producers and consumers spin on different lines
+        alignas(64) std::atomic<size_t> enqueue_;
+        alignas(64) std::atomic<size_t> dequeue_;
+    };
+}  // namespace MeltiCache
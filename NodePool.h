@@ -0,0 +1,141 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace MeltiCache
+{
+    // 节点在池中的槽位编号，用 32 位下标代替指针串联链表
+    using SlotIndex = uint32_t;
+    constexpr SlotIndex kNullSlot = UINT32_MAX;
+
+    // Per-cache slab allocator. Nodes live in fixed-size chunks so their addresses never move,
+    // released slots go back on a free list and are handed out again by allocate(), so once the
+    // cache is warm inserts and evictions do not touch the heap.
+    // Every slot also has a pin counter for ValueHandle: a pinned slot that is released is parked on a
+    // retired list and only handed out again once its last handle is gone.
+    template <typename Node>
+    class NodePool
+    {
+      public:
+        explicit NodePool(size_t expectedNodes = 0) : chunkShift_(chooseShift(expectedNodes)), size_(0)
+        {
+            reserve(expectedNodes);
+        }
+
+        NodePool(const NodePool &) = delete;
+        NodePool &operator=(const NodePool &) = delete;
+
+        SlotIndex allocate()
+        {
+            if (freeSlots_.empty())
+            {
+                reclaimRetired();
+            }
+            if (freeSlots_.empty())
+            {
+                grow();
+            }
+            SlotIndex slot = freeSlots_.back();
+            freeSlots_.pop_back();
+            return slot;
+        }
+
+        // 回收槽位，节点对象本身保留，下一次 allocate 直接复用；还被句柄钉住的槽位先挂到retired_上
+        void release(SlotIndex slot)
+        {
+            if (isPinned(slot))
+            {
+                retired_.push_back(slot);
+                return;
+            }
+            freeSlots_.push_back(slot);
+        }
+
+        // 句柄钉住槽位时在持锁状态下加一，句柄析构时无锁减一
+        std::atomic<uint32_t> &pins(SlotIndex slot) const { return pins_[slot >> chunkShift_][slot & chunkMask()]; }
+        bool isPinned(SlotIndex slot) const { return pins(slot).load(std::memory_order_acquire) != 0; }
+
+        Node &operator[](SlotIndex slot) { return chunks_[slot >> chunkShift_][slot & chunkMask()]; }
+        const Node &operator[](SlotIndex slot) const { return chunks_[slot >> chunkShift_][slot & chunkMask()]; }
+
+        // 批量操作时先预取节点，后面真正读写时不用再等内存
+        void prefetch(SlotIndex slot) const
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(&(*this)[slot]);
+#else
+            (void)slot;
+#endif
+        }
+
+        void reserve(size_t nodes)
+        {
+            while (size_ < nodes)
+            {
+                grow();
+            }
+        }
+
+        size_t capacity() const { return size_; }
+        size_t inUse() const { return size_ - freeSlots_.size(); }
+
+      private:
+        static constexpr unsigned kMinShift = 4;   // 16 nodes per chunk
+        static constexpr unsigned kMaxShift = 12;  // 4096 nodes per chunk
+
+        static unsigned chooseShift(size_t expectedNodes)
+        {
+            unsigned shift = kMinShift;
+            while (shift < kMaxShift && (size_t(1) << shift) < expectedNodes)
+            {
+                ++shift;
+            }
+            return shift;
+        }
+
+        size_t chunkSize() const { return size_t(1) << chunkShift_; }
+        size_t chunkMask() const { return chunkSize() - 1; }
+
+        // 把已经没有句柄的retired槽位放回空闲表
+        void reclaimRetired()
+        {
+            size_t kept = 0;
+            for (SlotIndex slot : retired_)
+            {
+                if (isPinned(slot))
+                    retired_[kept++] = slot;
+                else
+                    freeSlots_.push_back(slot);
+            }
+            retired_.resize(kept);
+        }
+
+        void grow()
+        {
+            chunks_.emplace_back(new Node[chunkSize()]);
+            pins_.emplace_back(new std::atomic<uint32_t>[chunkSize()]);
+            for (size_t i = 0; i < chunkSize(); ++i)
+            {
+                pins_.back()[i].store(0, std::memory_order_relaxed);
+            }
+            size_t base = size_;
+            size_ += chunkSize();
+            freeSlots_.reserve(size_);
+            // 倒序压栈，低编号的槽位先被分配出去
+            for (size_t i = size_; i > base; --i)
+            {
+                freeSlots_.push_back(static_cast<SlotIndex>(i - 1));
+            }
+        }
+
+        unsigned chunkShift_;
+        size_t size_;
+        std::vector<std::unique_ptr<Node[]>> chunks_;
+        std::vector<std::unique_ptr<std::atomic<uint32_t>[]>> pins_;
+        std::vector<SlotIndex> freeSlots_;
+        std::vector<SlotIndex> retired_;  // released while pinned
+    };
+}  // namespace MeltiCache
@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace MeltiCache
+{
+    // Lossy, striped ring buffer of access records. Readers append with a single CAS on the stripe picked
+    // by their thread; when a stripe is full or the CAS loses, the record is simply dropped, which only makes
+    // the replacement policy slightly less precise. One thread at a time (the cache's maintenance pass,
+    // holding the exclusive policy lock) drains all stripes and replays the records.
+    // Records are 64-bit words, kEmpty marks a claimed cell whose record has not been published yet.
+    class ReadBuffer
+    {
+      public:
+        static constexpr uint64_t kEmpty = UINT64_MAX;
+        static constexpr size_t kStripes = 16;
+        static constexpr uint32_t kStripeCapacity = 32;
+
+        ReadBuffer()
+        {
+            for (Stripe &stripe : stripes_)
+            {
+                stripe.head.store(0, std::memory_order_relaxed);
+                stripe.tail.store(0, std::memory_order_relaxed);
+                for (auto &cell : stripe.cells)
+                {
+                    cell.store(kEmpty, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        ReadBuffer(const ReadBuffer &) = delete;
+        ReadBuffer &operator=(const ReadBuffer &) = delete;
+
+        // returns false when the caller's stripe is full and a drain is due
+        bool record(uint64_t entry)
+        {
+            Stripe &stripe = stripes_[stripeIndex()];
+            uint32_t head = stripe.head.load(std::memory_order_acquire);
+            uint32_t tail = stripe.tail.load(std::memory_order_relaxed);
+            if (tail - head >= kStripeCapacity)
+            {
+                return false;
+            }
+            if (stripe.tail.compare_exchange_strong(tail, tail + 1, std::memory_order_relaxed))
+            {
+                stripe.cells[tail & (kStripeCapacity - 1)].store(entry, std::memory_order_release);
+            }
+            return tail + 1 - head < kStripeCapacity;
+        }
+
+        // Replays every published record through apply. Must not run concurrently with itself.
+        template <typename Apply>
+        void drain(Apply &&apply)
+        {
+            for (Stripe &stripe : stripes_)
+            {
+                uint32_t head = stripe.head.load(std::memory_order_relaxed);
+                uint32_t tail = stripe.tail.load(std::memory_order_acquire);
+                for (; head != tail; ++head)
+                {
+                    auto &cell = stripe.cells[head & (kStripeCapacity - 1)];
+                    uint64_t entry = cell.load(std::memory_order_acquire);
+                    if (entry == kEmpty)
+                    {
+                        break;  // writer claimed the cell but has not published yet, pick it up next time
+                    }
+                    cell.store(kEmpty, std::memory_order_relaxed);
+                    apply(entry);
+                }
+                stripe.head.store(head, std::memory_order_release);
+            }
+        }
+
+      private:
+        struct alignas(64) Stripe
+        {
+            std::atomic<uint32_t> head;
+            std::atomic<uint32_t> tail;
+            std::atomic<uint64_t> cells[kStripeCapacity];
+        };
+
+        static size_t stripeIndex()
+        {
+            static thread_local size_t index = std::hash<std::thread::id>{}(std::this_thread::get_id()) * 0x9e3779b9u;
+            return (index >> 16) & (kStripes - 1);
+        }
+
+        Stripe stripes_[kStripes];
+    };
+}  // namespace MeltiCache
@@ -0,0 +1,261 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+
+#include "FlatIndex.h"
+#include "GhostList.h"
+#include "ICachePolicy.h"
+#include "MpmcQueue.h"
+#include "NodePool.h"
+
+// S3-FIFO (Yang et al., SOSP 2023): three FIFO queues and no recency list. New keys enter a small queue
+// (smallRatio of the capacity, 10% by default); a key that is hit before it reaches the front moves to the
+// main queue, the others are evicted and remembered by fingerprint in a ghost FIFO. A key inserted again while
+// it is a ghost goes straight to the main queue. The main queue evicts like CLOCK with a 2-bit frequency:
+// a key at the front with a non-zero count is pushed back with the count decremented.
+// A hit only bumps the node's saturating counter under the shared index lock, nothing is relinked, so hot
+// keys stay read-mostly. The queues are lock-free MPMC rings of slot indexes: writers push and pop them, and
+// decide what to evict, under the shared lock too, so concurrent writers only serialize on the exclusive
+// lock for the index insert and the final unlink of a victim.
+template <typename Key, typename Value>
+class S3FifoCache : public MeltiCache::ICachePolicy<Key, Value>
+{
+  private:
+    struct Node
+    {
+        Key key_;
+        Value value_;
+        uint64_t hash_ = 0;
+        std::atomic<uint8_t> freq_{0};  // 0..kMaxFreq, bumped by hits without the exclusive lock
+    };
+
+    using NodePool = MeltiCache::NodePool<Node>;
+    using Slot = MeltiCache::SlotIndex;
+
+    static constexpr uint8_t kMaxFreq = 3;
+    // room for the entries of both queues plus the ones writers are still queueing or evicting
+    static constexpr size_t kQueueSlack = 1024;
+
+  public:
+    explicit S3FifoCache(int capacity, double smallRatio = 0.1)
+        : capacity_(capacity > 0 ? capacity : 0),
+          smallCapacity_(std::max<size_t>(1, static_cast<size_t>(capacity_ * smallRatio))),
+          size_(0),
+          smallSize_(0),
+          small_(capacity_ + kQueueSlack),
+          main_(capacity_ + kQueueSlack),
+          ghost_(capacity_ > smallCapacity_ ? capacity_ - smallCapacity_ : 1),
+          pool_(capacity_ + 1)
+    {
+        map_.reserve(capacity_);
+    }
+
+    void put(const Key& key, const Value& value) override
+    {
+        S3FifoCache::putWithHash(key, map_.hash(key), value);
+    }
+
+    void putWithHash(const Key& key, uint64_t hash, const Value& value) override
+    {
+        insert(key, hash, [&]() -> const Value& { return value; }, true);
+    }
+
+    void put(Key&& key, Value&& value) override
+    {
+        uint64_t hash = map_.hash(key);
+        S3FifoCache::putWithHash(std::move(key), hash, std::move(value));
+    }
+
+    void putWithHash(Key&& key, uint64_t hash, Value&& value) override
+    {
+        insert(std::move(key), hash, [&]() -> Value&& { return std::move(value); }, true);
+    }
+
+    bool insertIfAbsent(const Key& key, const std::function<Value()>& makeValue) override
+    {
+        return insert(key, map_.hash(key), makeValue, false);
+    }
+
+    bool insertIfAbsentWithHash(const Key& key, uint64_t hash, const std::function<Value()>& makeValue) override
+    {
+        return insert(key, hash, makeValue, false);
+    }
+
+    bool get(const Key& key, Value& value) override { return S3FifoCache::getWithHash(key, map_.hash(key), value); }
+
+    bool getWithHash(const Key& key, uint64_t hash, Value& value) override
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        Slot slot = findSlot(key, hash);
+        if (slot == MeltiCache::kNullSlot) return false;
+        value = pool_[slot].value_;
+        touch(pool_[slot]);
+        return true;
+    }
+
+    Value get(const Key& key) override
+    {
+        Value value{};
+        get(key, value);
+        return value;
+    }
+
+    // resident entries, S3-FIFO has no weigher; may briefly read one above the capacity while writers evict
+    size_t weightedSize() override
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return map_.size();
+    }
+
+  private:
+    Slot findSlot(const Key& key, uint64_t hash) const
+    {
+        return map_.find(hash, [&](Slot slot) { return pool_[slot].key_ == key; });
+    }
+
+    // Lossy saturating increment: two racing hits may count once, which CLOCK-style aging tolerates, and a
+    // saturated counter is only read, so the hottest keys do not bounce their cache line between cores.
+    static void touch(Node& node)
+    {
+        uint8_t freq = node.freq_.load(std::memory_order_relaxed);
+        if (freq < kMaxFreq) node.freq_.store(freq + 1, std::memory_order_relaxed);
+    }
+
+    // Writes make() for a new key, or over an existing one when overwrite is set (which also counts as a hit).
+    // Returns whether anything was written.
+    template <typename K, typename Make>
+    bool insert(K&& key, uint64_t hash, Make&& make, bool overwrite)
+    {
+        if (capacity_ == 0) return false;
+        Slot slot;
+        bool toMain;
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            Slot found = findSlot(key, hash);
+            if (found != MeltiCache::kNullSlot)
+            {
+                if (!overwrite) return false;
+                pool_[found].value_ = make();
+                touch(pool_[found]);
+                return true;
+            }
+            slot = pool_.allocate();
+            Node& node = pool_[slot];
+            node.key_ = std::forward<K>(key);
+            node.value_ = make();
+            node.hash_ = hash;
+            node.freq_.store(0, std::memory_order_relaxed);
+            map_.insert(hash, slot);
+            toMain = ghost_.containsHash(hash);
+            size_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (toMain)
+        {
+            push(main_, slot);
+        }
+        else
+        {
+            smallSize_.fetch_add(1, std::memory_order_relaxed);
+            push(small_, slot);
+        }
+        // each eviction is claimed by taking one off size_ first, so racing writers never evict the same excess
+        for (size_t size = size_.load(std::memory_order_relaxed); size > capacity_;)
+        {
+            if (!size_.compare_exchange_weak(size, size - 1, std::memory_order_relaxed)) continue;
+            if (!evictOne())
+            {
+                // everything left is still being queued by other writers, they evict for themselves
+                size_.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            size = size_.load(std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    static void push(MeltiCache::MpmcQueue<Slot>& queue, Slot slot)
+    {
+        while (!queue.tryPush(slot))
+        {
+            std::this_thread::yield();  // only with more writers in flight than kQueueSlack
+        }
+    }
+
+    // Evicts one entry, false if both queues are empty. The victim is chosen under the shared lock: small
+    // queue fronts that were hit move to the main queue, main queue fronts with a non-zero count go round again.
+    bool evictOne()
+    {
+        Slot victim = MeltiCache::kNullSlot;
+        bool ghost = false;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            while (victim == MeltiCache::kNullSlot)
+            {
+                Slot slot;
+                if (smallSize_.load(std::memory_order_relaxed) >= smallCapacity_ && small_.tryPop(slot))
+                {
+                    smallSize_.fetch_sub(1, std::memory_order_relaxed);
+                    Node& node = pool_[slot];
+                    if (node.freq_.load(std::memory_order_relaxed) > 0)
+                    {
+                        node.freq_.store(0, std::memory_order_relaxed);
+                        push(main_, slot);
+                        continue;
+                    }
+                    victim = slot;
+                    ghost = true;
+                }
+                else if (main_.tryPop(slot))
+                {
+                    Node& node = pool_[slot];
+                    uint8_t freq = node.freq_.load(std::memory_order_relaxed);
+                    if (freq > 0)
+                    {
+                        node.freq_.store(freq - 1, std::memory_order_relaxed);
+                        push(main_, slot);
+                        continue;
+                    }
+                    victim = slot;
+                }
+                else if (small_.tryPop(slot))
+                {
+                    // the main queue is empty, the small queue may grow into its share
+                    smallSize_.fetch_sub(1, std::memory_order_relaxed);
+                    victim = slot;
+                    ghost = true;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        Node& node = pool_[victim];
+        map_.erase(node.hash_, victim);
+        if (ghost) ghost_.pushHash(node.hash_);
+        node.key_ = Key();
+        node.value_ = Value();
+        pool_.release(victim);
+        return true;
+    }
+
+  private:
+    size_t capacity_;
+    size_t smallCapacity_;
+    std::atomic<size_t> size_;       // entries in the cache minus evictions claimed by writers
+    std::atomic<size_t> smallSize_;  // entries in the small queue
+    MeltiCache::MpmcQueue<Slot> small_;
+    MeltiCache::MpmcQueue<Slot> main_;
+    MeltiCache::GhostList<Key> ghost_;  // evicted from the small queue, sized like the main queue
+    NodePool pool_;
+    MeltiCache::FlatIndex<Key> map_;
+    std::shared_mutex mutex_;
+};
@@ -0,0 +1,297 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "CacheStats.h"
+#include "Hasher.h"
+#include "ICachePolicy.h"
+#include "Snapshot.h"
+
+// Sharded front-end over any cache policy (LruCache, LfuCache, ArcCache ...).
+// Every shard is a full, independent policy instance with its own lock, so an ArcCache shard keeps its
+// own LRU/LFU split and adapts on its own. The key is hashed once per call: the high bits pick the shard and
+// the same hash is handed to the shard's getWithHash/putWithHash for its table probe.
+template <typename Key, typename Value, typename Policy>
+class ShardedCache : public MeltiCache::ICachePolicy<Key, Value>
+{
+  public:
+    // capacity is the total capacity, split evenly over the shards; policyArgs are passed to every
+    // shard after its capacity, e.g. ShardedCache<K, V, ArcCache<K, V>>(1024, 16, transformNeed).
+    // With a weigher in policyArgs capacity is the total weight budget, e.g. (1 << 30, 16, 2, weigher)
+    template <typename... Args>
+    ShardedCache(size_t capacity, size_t shardNum, Args &&...policyArgs)
+        : shardNum_(shardNum ? shardNum : defaultShardNum())
+    {
+        shardCapacity_ = (capacity + shardNum_ - 1) / shardNum_;
+        shards_.reserve(shardNum_);
+        for (size_t i = 0; i < shardNum_; ++i)
+        {
+            shards_.emplace_back(std::make_unique<Policy>(shardCapacity_, policyArgs...));
+        }
+    }
+
+    void put(const Key &key, const Value &value) override
+    {
+        uint64_t hash = hashOf(key);
+        shardAt(hash).putWithHash(key, hash, value);
+    }
+
+    void putWithHash(const Key &key, uint64_t hash, const Value &value) override
+    {
+        shardAt(hash).putWithHash(key, hash, value);
+    }
+
+    void put(Key &&key, Value &&value) override
+    {
+        uint64_t hash = hashOf(key);
+        shardAt(hash).putWithHash(std::move(key), hash, std::move(value));
+    }
+
+    void putWithHash(Key &&key, uint64_t hash, Value &&value) override
+    {
+        shardAt(hash).putWithHash(std::move(key), hash, std::move(value));
+    }
+
+    bool insertIfAbsent(const Key &key, const std::function<Value()> &makeValue) override
+    {
+        uint64_t hash = hashOf(key);
+        return shardAt(hash).insertIfAbsentWithHash(key, hash, makeValue);
+    }
+
+    bool insertIfAbsentWithHash(const Key &key, uint64_t hash, const std::function<Value()> &makeValue) override
+    {
+        return shardAt(hash).insertIfAbsentWithHash(key, hash, makeValue);
+    }
+
+    // expiry, only for policies that support it (LruCache, LfuCache, ArcCache)
+    void put(const Key &key, const Value &value, std::chrono::nanoseconds ttl)
+    {
+        uint64_t hash = hashOf(key);
+        shardAt(hash).putWithHash(key, hash, value, ttl);
+    }
+
+    void put(Key &&key, Value &&value, std::chrono::nanoseconds ttl)
+    {
+        uint64_t hash = hashOf(key);
+        shardAt(hash).putWithHash(std::move(key), hash, std::move(value), ttl);
+    }
+
+    void setExpireAfterWrite(std::chrono::nanoseconds ttl)
+    {
+        for (auto &shard : shards_)
+        {
+            shard->setExpireAfterWrite(ttl);
+        }
+    }
+
+    void setExpireAfterAccess(std::chrono::nanoseconds ttl)
+    {
+        for (auto &shard : shards_)
+        {
+            shard->setExpireAfterAccess(ttl);
+        }
+    }
+
+    // runs every shard's maintenance, one shard lock at a time
+    void cleanUp()
+    {
+        for (auto &shard : shards_)
+        {
+            shard->cleanUp();
+        }
+    }
+
+    bool get(const Key &key, Value &value) override
+    {
+        uint64_t hash = hashOf(key);
+        return shardAt(hash).getWithHash(key, hash, value);
+    }
+
+    bool getWithHash(const Key &key, uint64_t hash, Value &value) override
+    {
+        return shardAt(hash).getWithHash(key, hash, value);
+    }
+
+    Value get(const Key &key) override
+    {
+        Value value{};
+        get(key, value);
+        return value;
+    }
+
+    MeltiCache::ValueHandle<Value> getHandle(const Key &key) override
+    {
+        uint64_t hash = hashOf(key);
+        return shardAt(hash).getHandleWithHash(key, hash);
+    }
+
+    MeltiCache::ValueHandle<Value> getHandleWithHash(const Key &key, uint64_t hash) override
+    {
+        return shardAt(hash).getHandleWithHash(key, hash);
+    }
+
+    // Hashes every key once, groups the batch by shard and hands each shard its keys and their hashes in one
+    // call, so each shard lock is taken once per batch instead of once per key and never covers hashing.
+    size_t getMany(const std::vector<Key> &keys, std::vector<Value> &values, std::vector<bool> &found) override
+    {
+        values.resize(keys.size());
+        found.assign(keys.size(), false);
+        std::vector<uint64_t> hashes = this->hashAll(keys);
+        return getManyWithHash(keys, hashes, MeltiCache::BatchRange{nullptr, 0, keys.size()}, values, found);
+    }
+
+    void putMany(const std::vector<Key> &keys, const std::vector<Value> &values) override
+    {
+        std::vector<uint64_t> hashes = this->hashAll(keys);
+        putManyWithHash(keys, hashes, values, MeltiCache::BatchRange{nullptr, 0, keys.size()});
+    }
+
+    // Each shard gets a view of the batch (the indexes of its keys), not a copy: keys, hashes and values are
+    // read and written in place at their original positions.
+    size_t getManyWithHash(const std::vector<Key> &keys, const std::vector<uint64_t> &hashes,
+                           MeltiCache::BatchRange range, std::vector<Value> &values,
+                           std::vector<bool> &found) override
+    {
+        std::vector<size_t> order;
+        std::vector<size_t> offsets;
+        groupByShard(hashes, range, order, offsets);
+
+        size_t hits = 0;
+        for (size_t s = 0; s < shardNum_; ++s)
+        {
+            if (offsets[s] == offsets[s + 1]) continue;
+            hits += shards_[s]->getManyWithHash(keys, hashes, MeltiCache::BatchRange{order.data(), offsets[s],
+                                                                                     offsets[s + 1]},
+                                                values, found);
+        }
+        return hits;
+    }
+
+    void putManyWithHash(const std::vector<Key> &keys, const std::vector<uint64_t> &hashes,
+                         const std::vector<Value> &values, MeltiCache::BatchRange range) override
+    {
+        std::vector<size_t> order;
+        std::vector<size_t> offsets;
+        groupByShard(hashes, range, order, offsets);
+
+        for (size_t s = 0; s < shardNum_; ++s)
+        {
+            if (offsets[s] == offsets[s + 1]) continue;
+            shards_[s]->putManyWithHash(keys, hashes, values,
+                                        MeltiCache::BatchRange{order.data(), offsets[s], offsets[s + 1]});
+        }
+    }
+
+    // sum over the shards, each shard is read under its own lock
+    size_t weightedSize() override
+    {
+        size_t total = 0;
+        for (auto &shard : shards_)
+        {
+            total += shard->weightedSize();
+        }
+        return total;
+    }
+
+    // Sum over the shards, for policies with stats() (LruCache, LfuCache, ArcCache); shard(i).stats() gives the
+    // per-shard view. Latency histograms are merged bucket by bucket, so percentiles stay exact to the bucket.
+    MeltiCache::CacheStatsSnapshot stats()
+    {
+        MeltiCache::CacheStatsSnapshot total;
+        for (auto &shard : shards_)
+        {
+            total += shard->stats();
+        }
+        return total;
+    }
+
+    void setLatencySampling(uint32_t period)
+    {
+        for (auto &shard : shards_)
+        {
+            shard->setLatencySampling(period);
+        }
+    }
+
+    // Snapshot for policies that write snapshot sections (ArcCache): one section per shard, each copied under
+    // its own shard's lock in turn, so a snapshot pauses writers of one shard at a time and holds one shard's
+    // copy in memory.
+    bool snapshot(const std::string &path)
+    {
+        MeltiCache::SnapshotWriter writer(path);
+        MeltiCache::writeSnapshotHeader(writer, static_cast<uint32_t>(shardNum_));
+        for (auto &shard : shards_)
+        {
+            shard->writeSnapshot(writer);
+        }
+        return writer.commit();
+    }
+
+    // Streams a snapshot back shard by shard. Keys route to the same shard as long as the shard count is the
+    // same; a snapshot with another shard count is refused (returns false) and the cache starts empty.
+    bool load(const std::string &path)
+    {
+        MeltiCache::SnapshotReader reader(path);
+        if (!MeltiCache::readSnapshotHeader(reader, static_cast<uint32_t>(shardNum_))) return false;
+        for (auto &shard : shards_)
+        {
+            if (!shard->readSnapshot(reader)) return false;
+        }
+        return true;
+    }
+
+    // aggregate capacity over all shards
+    size_t capacity() const { return shardCapacity_ * shardNum_; }
+    size_t shardCount() const { return shardNum_; }
+    Policy &shard(size_t index) { return *shards_[index]; }
+
+  private:
+    static size_t defaultShardNum()
+    {
+        size_t cores = std::thread::hardware_concurrency();
+        return cores ? cores : 1;
+    }
+
+    static uint64_t hashOf(const Key &key) { return MeltiCache::Hasher<Key>{}(key); }
+
+    // Shards take the high 32 bits (multiply-shift instead of a division), the tables inside a shard the low
+    // ones, so keys of one shard still spread over the whole table.
+    size_t shardIndex(uint64_t hash) const { return static_cast<size_t>(((hash >> 32) * shardNum_) >> 32); }
+
+    Policy &shardAt(uint64_t hash) { return *shards_[shardIndex(hash)]; }
+
+    // counting sort of the batch range by shard: the key indexes of shard s are order[offsets[s] .. offsets[s + 1])
+    void groupByShard(const std::vector<uint64_t> &hashes, MeltiCache::BatchRange range, std::vector<size_t> &order,
+                      std::vector<size_t> &offsets) const
+    {
+        std::vector<size_t> shardOf(range.size());
+        offsets.assign(shardNum_ + 1, 0);
+        for (size_t i = range.begin; i < range.end; ++i)
+        {
+            shardOf[i - range.begin] = shardIndex(hashes[range[i]]);
+            ++offsets[shardOf[i - range.begin] + 1];
+        }
+        for (size_t s = 0; s < shardNum_; ++s)
+        {
+            offsets[s + 1] += offsets[s];
+        }
+        order.resize(range.size());
+        std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t i = range.begin; i < range.end; ++i)
+        {
+            order[next[shardOf[i - range.begin]]++] = range[i];
+        }
+    }
+
+  private:
+    size_t shardNum_;
+    size_t shardCapacity_;
+    std::vector<std::unique_ptr<Policy>> shards_;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "Hasher.h"
+
+namespace MeltiCache
+{
+    // Coalesces concurrent calls for the same key: the first caller (the leader) runs the function, callers
+    // that arrive while it runs block on the leader's result instead of running it again, and all of them get
+    // the same value or the same exception. Once the call finishes the key is forgotten, so a failed call is
+    // retried by the next caller rather than cached.
+    // The lock only guards the table of in-flight calls, the function itself runs without it.
+    template <typename Key, typename Value>
+    class SingleFlight
+    {
+      public:
+        template <typename Fn>
+        Value run(const Key &key, Fn &&fn)
+        {
+            std::promise<Value> promise;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                auto it = calls_.find(key);
+                if (it != calls_.end())
+                {
+                    std::shared_future<Value> result = it->second;
+                    lock.unlock();
+                    return result.get();
+                }
+                calls_.emplace(key, promise.get_future().share());
+            }
+            try
+            {
+                Value value = fn();
+                promise.set_value(value);
+                forget(key);
+                return value;
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+                forget(key);
+                throw;
+            }
+        }
+
+        // calls currently in flight
+        size_t size()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return calls_.size();
+        }
+
+      private:
+        void forget(const Key &key)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            calls_.erase(key);
+        }
+
+        std::mutex mutex_;
+        std::unordered_map<Key, std::shared_future<Value>, Hasher<Key>> calls_;
+    };
+}  // namespace MeltiCache
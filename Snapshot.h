@@ -0,0 +1,234 @@
+#pragma once
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace MeltiCache
+{
+    // Snapshot file: a header (magic, format version, number of sections) followed by one section per cache
+    // instance, e.g. one per shard. Numbers are native-endian, so a snapshot is meant to be read back on the
+    // machine type that wrote it. The section layout belongs to the policy that writes it (see
+    // ArcCache::writeSnapshot); keys and values are encoded by SnapshotCodec.
+    struct SnapshotHeader
+    {
+        static constexpr uint64_t kMagic = 0x3150414e53434d4dULL;  // "MMCSNAP1"
+        static constexpr uint32_t kVersion = 1;
+
+        uint64_t magic = kMagic;
+        uint32_t version = kVersion;
+        uint32_t sections = 0;
+    };
+
+    // Buffered, append-only writer. The data goes to path + ".tmp", and commit() syncs it and renames it over
+    // path, so readers never see a half-written snapshot and a failed snapshot leaves the previous one in place.
+    // Errors are sticky: after the first failed write every call is a no-op and commit() returns false.
+    class SnapshotWriter
+    {
+      public:
+        explicit SnapshotWriter(const std::string &path) : path_(path), tmpPath_(path + ".tmp"), committed_(false)
+        {
+            fd_ = ::open(tmpPath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            buffer_.reserve(kBufferSize);
+        }
+
+        ~SnapshotWriter()
+        {
+            if (fd_ >= 0) ::close(fd_);
+            if (!committed_) ::unlink(tmpPath_.c_str());
+        }
+
+        SnapshotWriter(const SnapshotWriter &) = delete;
+        SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+        bool ok() const { return fd_ >= 0; }
+
+        void write(const void *data, size_t size)
+        {
+            if (fd_ < 0) return;
+            if (buffer_.size() + size > kBufferSize)
+            {
+                flush();
+                if (size >= kBufferSize)
+                {
+                    writeAll(static_cast<const char *>(data), size);
+                    return;
+                }
+            }
+            const char *bytes = static_cast<const char *>(data);
+            buffer_.insert(buffer_.end(), bytes, bytes + size);
+        }
+
+        template <typename T>
+        void writeValue(const T &value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "writeValue needs a trivially copyable type");
+            write(&value, sizeof(T));
+        }
+
+        bool commit()
+        {
+            flush();
+            if (fd_ < 0) return false;
+            bool ok = ::fsync(fd_) == 0;
+            ok = ::close(fd_) == 0 && ok;
+            fd_ = -1;
+            if (!ok || ::rename(tmpPath_.c_str(), path_.c_str()) != 0) return false;
+            committed_ = true;
+            return true;
+        }
+
+      private:
+        static constexpr size_t kBufferSize = size_t(1) << 20;
+
+        void flush()
+        {
+            if (fd_ >= 0 && !buffer_.empty()) writeAll(buffer_.data(), buffer_.size());
+            buffer_.clear();
+        }
+
+        void writeAll(const char *data, size_t size)
+        {
+            while (size > 0 && fd_ >= 0)
+            {
+                ssize_t written = ::write(fd_, data, size);
+                if (written < 0)
+                {
+                    if (errno == EINTR) continue;
+                    ::close(fd_);
+                    fd_ = -1;
+                    return;
+                }
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+        }
+
+        std::string path_;
+        std::string tmpPath_;
+        int fd_;
+        bool committed_;
+        std::vector<char> buffer_;
+    };
+
+    // Streams a snapshot straight out of a read-only mapping of the file: nothing is read ahead into memory
+    // beyond what the kernel pages in, and the mapping is advised for sequential access so a load runs at
+    // disk speed. Reads past the end (a truncated or foreign file) fail and leave ok() false.
+    class SnapshotReader
+    {
+      public:
+        explicit SnapshotReader(const std::string &path) : data_(nullptr), size_(0), offset_(0), ok_(false)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) return;
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                void *data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED)
+                {
+                    ::madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                    data_ = static_cast<const char *>(data);
+                    size_ = static_cast<size_t>(st.st_size);
+                    ok_ = true;
+                }
+            }
+            ::close(fd);
+        }
+
+        ~SnapshotReader()
+        {
+            if (data_) ::munmap(const_cast<char *>(data_), size_);
+        }
+
+        SnapshotReader(const SnapshotReader &) = delete;
+        SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+        bool ok() const { return ok_; }
+        bool atEnd() const { return offset_ == size_; }
+
+        // the next size bytes of the mapping, nullptr (and ok() false) when the file is shorter
+        const char *take(size_t size)
+        {
+            if (!ok_ || size > size_ - offset_)
+            {
+                ok_ = false;
+                return nullptr;
+            }
+            const char *data = data_ + offset_;
+            offset_ += size;
+            return data;
+        }
+
+        template <typename T>
+        bool readValue(T &value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "readValue needs a trivially copyable type");
+            const char *data = take(sizeof(T));
+            if (!data) return false;
+            std::memcpy(&value, data, sizeof(T));
+            return true;
+        }
+
+      private:
+        const char *data_;
+        size_t size_;
+        size_t offset_;
+        bool ok_;
+    };
+
+    // every snapshot file starts with one header
+    inline void writeSnapshotHeader(SnapshotWriter &writer, uint32_t sections)
+    {
+        SnapshotHeader header;
+        header.sections = sections;
+        writer.writeValue(header);
+    }
+
+    // true if the file starts with a header of this format version announcing the expected number of sections
+    inline bool readSnapshotHeader(SnapshotReader &reader, uint32_t sections)
+    {
+        SnapshotHeader header;
+        return reader.readValue(header) && header.magic == SnapshotHeader::kMagic &&
+               header.version == SnapshotHeader::kVersion && header.sections == sections;
+    }
+
+    // How keys and values are stored in a snapshot. Trivially copyable types are copied byte for byte and
+    // std::string is length-prefixed; specialize it for other types.
+    template <typename T, typename = void>
+    struct SnapshotCodec
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "specialize MeltiCache::SnapshotCodec for this type");
+
+        static void write(SnapshotWriter &writer, const T &value) { writer.writeValue(value); }
+        static bool read(SnapshotReader &reader, T &value) { return reader.readValue(value); }
+    };
+
+    template <>
+    struct SnapshotCodec<std::string>
+    {
+        static void write(SnapshotWriter &writer, const std::string &value)
+        {
+            writer.writeValue(static_cast<uint64_t>(value.size()));
+            writer.write(value.data(), value.size());
+        }
+
+        static bool read(SnapshotReader &reader, std::string &value)
+        {
+            uint64_t size = 0;
+            if (!reader.readValue(size)) return false;
+            const char *data = reader.take(static_cast<size_t>(size));
+            if (!data) return false;
+            value.assign(data, static_cast<size_t>(size));
+            return true;
+        }
+    };
+}  // namespace MeltiCache
@@ -1,8 +1,32 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <climits>
+#include <cstdio>
 #include <iostream>
+#include <memory>
+#include <shared_mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
 
 #include "ArcCache.h"
+#include "CacheBuilder.h"
+#include "CacheStats.h"
+#include "ClockCache.h"
+#include "Executor.h"
+#include "FlatIndex.h"
+#include "Hasher.h"
+#include "LFUCache.h"
+#include "LirsCache.h"
+#include "NodePool.h"
+#include "S3FifoCache.h"
+#include "ShardedCache.h"
+#include "TinyLfuCache.h"
 
 using namespace std;
 
@@ -56,6 +80,44 @@ void testArcLfu()
         cout << "Passed." << endl;
     }
 
+    // 测试点 3: 节点从桶中间摘走(O(1)), 最小频数的桶被搬空后, 淘汰跟着落到下一个最小频数
+    // 场景: 容量 100。插入 0..99 (频次都是1), 访问所有偶数key (从频次1的桶中间移到频次2)。
+    // 再插入 100..149: 50 次淘汰只落在频次1的奇数key上, 按插入顺序; 偶数key全部留下。
+    // 接着访问 100..149 把频次1的桶搬空, 再插入 150, 应淘汰频次2里最早进桶的 0。
+    {
+        cout << "[Test 3] Min-Frequency Eviction After Bucket Moves..." << endl;
+        ArcLfu<int, int> cache(100);
+        for (int i = 0; i < 100; ++i)
+        {
+            cache.put(i, i);
+        }
+        int val;
+        for (int i = 0; i < 100; i += 2)
+        {
+            assert(cache.get(i, val) && val == i);
+        }
+        for (int i = 100; i < 150; ++i)
+        {
+            cache.put(i, i);
+        }
+        for (int i = 100; i < 150; ++i)
+        {
+            assert(cache.get(i, val) && val == i);
+        }
+        cache.put(150, 150);
+        assert(!cache.get(0, val));
+        for (int i = 2; i < 100; i += 2)
+        {
+            assert(cache.get(i, val) && val == i);
+        }
+        for (int i = 1; i < 100; i += 2)
+        {
+            assert(!cache.get(i, val));
+        }
+        assert(cache.get(150, val));
+        cout << "Passed." << endl;
+    }
+
     cout << "All ArcLfu tests passed!" << endl;
 }
 
@@ -124,12 +186,1249 @@ void testArcCache()
         cout << "Passed." << endl;
     }
 
+    // 测试点 3: Ghost 列表只记key的指纹, 淘汰时value立即释放, 自适应照旧
+    {
+        cout << "[Test 3] Ghost Keeps No Values..." << endl;
+        ArcCache<int, shared_ptr<int>> cache(2, 100);
+        auto tracked = make_shared<int>(1);
+        cache.put(1, tracked);
+        assert(tracked.use_count() == 2);
+        cache.put(2, make_shared<int>(2));
+        cache.put(3, make_shared<int>(3));  // 1 被淘汰进 Ghost
+        assert(tracked.use_count() == 1);
+        shared_ptr<int> value;
+        assert(!cache.get(1, value));
+        cache.put(1, tracked);  // 命中 Ghost, LRU 扩容
+        cache.put(4, make_shared<int>(4));
+        assert(cache.get(2, value) && *value == 2);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 4: 读命中只记进读缓冲, 不在读路径上挪链表; 下一次写先重放缓冲, 攒够次数的key这时晋升到 LFU,
+    // 之后 LRU 部分被新key冲刷一遍它也还在, 没读过的 2 被淘汰
+    {
+        cout << "[Test 4] Buffered Hits Promote On Next Put..." << endl;
+        ArcCache<int, string> cache(2, 2);
+        cache.put(1, "A");
+        cache.put(2, "B");
+        string val;
+        assert(cache.get(1, val) && val == "A");
+        assert(cache.get(1, val) && val == "A");
+
+        cache.put(3, "C");
+        for (int i = 4; i < 10; ++i)
+        {
+            cache.put(i, to_string(i));
+        }
+        assert(cache.get(1, val) && val == "A");
+        assert(!cache.get(2, val));
+        cout << "Passed." << endl;
+    }
+
     cout << "All ArcCache tests passed!" << endl;
 }
 
+void testLfuCache()
+{
+    cout << "=== Testing LfuCache ===" << endl;
+
+    // 测试点 1: 频数表最多 kMaxFreqLimit 个list, maxAverageNum 配得再大(INT_MAX 也不会在 2*maxAverageNum 上溢出)
+    // 也不会开出几十MB的表; 老化阈值仍按配置来, 和容量无关: 平均频次没超过阈值, 冷掉的热key不会被老化掉
+    {
+        cout << "[Test 1] Frequency Table Bounded, Aging Threshold Kept..." << endl;
+        for (int maxAverageNum : {1000, 1000000, INT_MAX})
+        {
+            LfuCache<int, int> cache(4, maxAverageNum);
+            int val;
+            cache.put(0, 0);
+            for (int i = 0; i < 1000; ++i)
+            {
+                assert(cache.get(0, val));
+            }
+            for (int round = 0; round < 10; ++round)
+            {
+                for (int key = round * 3 + 1; key <= round * 3 + 3; ++key)
+                {
+                    cache.put(key, key);
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        assert(cache.get(key, val) && val == key);
+                    }
+                }
+            }
+            assert(cache.get(0, val) && val == 0);
+        }
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 老化之后的频数和整表扣减一样: 每个节点减 maxAverageNum/2, 最低为1, 相对顺序不变
+    // 场景: 容量 3, maxAverageNum 4。把 1,2,3 的频次访问到 2,5,8, 平均频次超过 4 触发老化, 变成 1,3,6。
+    // 插入 4 淘汰 1; 再把 4 访问到频次 3, 和 2 同频, 插入 5 时淘汰先进桶的 2
+    {
+        cout << "[Test 2] Frequencies After Aging..." << endl;
+        LfuCache<int, int> cache(3, 4);
+        int val;
+        auto hit = [&](int key, int times)
+        {
+            for (int i = 0; i < times; ++i)
+            {
+                assert(cache.get(key, val) && val == key);
+            }
+        };
+        cache.put(1, 1);
+        cache.put(2, 2);
+        cache.put(3, 3);
+        hit(3, 7);
+        hit(2, 2);
+        hit(1, 1);
+        hit(2, 2);  // 总频次 15, 平均 5 > 4, 老化
+        cache.put(4, 4);
+        assert(!cache.get(1, val));
+        hit(4, 2);
+        cache.put(5, 5);
+        assert(!cache.get(2, val));
+        hit(3, 1);
+        hit(4, 1);
+        hit(5, 1);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 3: 老化基准越过 2^32 回绕后频数照样折算对; 很久没被访问的节点老化扣减超过它的频数, 仍算频数1
+    // 场景: 容量 3。1,2 一直被访问, 期间多次老化, 基准跨过回绕点; 3 从不访问。插入 4 淘汰 3,
+    // 之后 1 比 2 热, 插入 5 淘汰 4, 再把 5 访问到比 2 热, 插入 6 淘汰 2
+    {
+        cout << "[Test 3] Aging Base Wraps Around..." << endl;
+        LfuCache<int, int> cache(3, 10);
+        cache.resetAgingBase(UINT32_MAX - 100);
+        int val;
+        cache.put(1, 1);
+        cache.put(2, 2);
+        cache.put(3, 3);
+        for (int i = 0; i < 3000; ++i)
+        {
+            assert(cache.get(1, val));
+            if (i % 4 == 0) assert(cache.get(2, val));
+        }
+        cache.put(4, 4);
+        assert(!cache.get(3, val));
+        cache.put(5, 5);
+        assert(!cache.get(4, val));
+        for (int i = 0; i < 20; ++i)
+        {
+            assert(cache.get(5, val) && cache.get(1, val));
+        }
+        cache.put(6, 6);
+        assert(!cache.get(2, val));
+        assert(cache.get(1, val) && cache.get(5, val) && cache.get(6, val));
+        cout << "Passed." << endl;
+    }
+
+    cout << "All LfuCache tests passed!" << endl;
+}
+
+void testShardedCache()
+{
+    cout << "=== Testing ShardedCache ===" << endl;
+
+    // 测试点 1: 分片 ARC / LFU / LRU 都能正常读写, 总容量为各分片之和
+    {
+        cout << "[Test 1] Sharded Put/Get..." << endl;
+        ShardedCache<int, string, ArcCache<int, string>> arc(64, 4, 2);
+        ShardedCache<int, string, LfuCache<int, string>> lfu(64, 4, 10);
+        HashLruCache<int, string> lru(64, 4);
+        assert(arc.shardCount() == 4 && arc.capacity() == 64);
+
+        for (int i = 0; i < 32; ++i)
+        {
+            arc.put(i, to_string(i));
+            lfu.put(i, to_string(i));
+            lru.put(i, to_string(i));
+        }
+        string val;
+        for (int i = 0; i < 32; ++i)
+        {
+            assert(arc.get(i, val) && val == to_string(i));
+            assert(lfu.get(i, val) && val == to_string(i));
+            assert(lru.get(i, val) && val == to_string(i));
+        }
+        assert(!arc.get(100, val));
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 批量接口, 结果按下标与 keys 对应, 未命中的 found 为 false
+    {
+        cout << "[Test 2] Batch getMany/putMany..." << endl;
+        ShardedCache<int, string, ArcCache<int, string>> arc(64, 4, 2);
+        LruCache<int, string> lru(64);
+        LfuCache<int, string> lfu(64, 10);
+
+        vector<int> keys;
+        vector<string> values;
+        for (int i = 0; i < 20; ++i)
+        {
+            keys.push_back(i);
+            values.push_back(to_string(i));
+        }
+        arc.putMany(keys, values);
+        lru.putMany(keys, values);
+        lfu.putMany(keys, values);
+
+        vector<int> query = {3, 100, 7, 19, 42};
+        vector<MeltiCache::ICachePolicy<int, string>*> caches = {&arc, &lru, &lfu};
+        for (auto* cache : caches)
+        {
+            vector<string> out;
+            vector<bool> found;
+            assert(cache->getMany(query, out, found) == 3);
+            assert(found[0] && out[0] == "3");
+            assert(!found[1] && !found[4]);
+            assert(found[2] && out[2] == "7");
+            assert(found[3] && out[3] == "19");
+        }
+        cout << "Passed." << endl;
+    }
+
+    cout << "All ShardedCache tests passed!" << endl;
+}
+
+void testClockCache()
+{
+    cout << "=== Testing ClockCache ===" << endl;
+
+    // 测试点 1: 二次机会。容量 2, 插入 1,2, 访问 1 (置引用位), 插入 3。
+    // 预期: 指针先清掉 1 的引用位, 淘汰未被引用的 2。
+    {
+        cout << "[Test 1] Second Chance..." << endl;
+        ClockCache<int, string> cache(2);
+        cache.put(1, "A");
+        cache.put(2, "B");
+
+        string val;
+        assert(cache.get(1, val) && val == "A");
+        cache.put(3, "C");
+
+        assert(cache.get(1, val));
+        assert(cache.get(3, val));
+        assert(!cache.get(2, val));
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: CLOCK-Pro 抗扫描。先把 0..3 访问成热数据, 再顺序扫过一大批只访问一次的 key。
+    // 预期: 扫描结束后热数据仍然命中。
+    {
+        cout << "[Test 2] CLOCK-Pro Scan Resistance..." << endl;
+        ClockProCache<int, string> cache(8);
+        string val;
+        for (int round = 0; round < 4; ++round)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                if (!cache.get(i, val)) cache.put(i, to_string(i));
+            }
+            for (int i = 100 + round * 8; i < 108 + round * 8; ++i)
+            {
+                cache.put(i, to_string(i));
+            }
+        }
+        for (int i = 1000; i < 1100; ++i)
+        {
+            cache.put(i, to_string(i));
+        }
+        int hot = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            hot += cache.get(i, val) ? 1 : 0;
+        }
+        assert(hot >= 3);
+        cout << "Passed." << endl;
+    }
+
+    cout << "All ClockCache tests passed!" << endl;
+}
+
+void testValueHandle()
+{
+    cout << "=== Testing ValueHandle ===" << endl;
+
+    // 测试点 1: 句柄钉住节点, 覆盖写和淘汰之后句柄读到的仍是旧值
+    {
+        cout << "[Test 1] Pinned Handle Survives Put/Evict..." << endl;
+        LruCache<int, string> lru(2);
+        LfuCache<int, string> lfu(2, 10);
+        ArcCache<int, string> arc(2, 2);
+        vector<MeltiCache::ICachePolicy<int, string> *> caches = {&lru, &lfu, &arc};
+        for (auto *cache : caches)
+        {
+            cache->put(1, "one");
+            MeltiCache::ValueHandle<string> handle = cache->getHandle(1);
+            assert(handle && *handle == "one");
+            cache->put(1, "uno");
+            for (int i = 2; i < 10; ++i)
+            {
+                cache->put(i, to_string(i));
+            }
+            assert(*handle == "one");
+            handle.reset();
+            assert(!cache->getHandle(100));
+        }
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 不支持钉住的策略和分片缓存同样能拿到句柄
+    {
+        cout << "[Test 2] Fallback And Sharded Handle..." << endl;
+        ClockCache<int, string> clock(4);
+        ShardedCache<int, string, ArcCache<int, string>> arc(16, 4, 2);
+        clock.put(7, "seven");
+        arc.put(7, "seven");
+        assert(*clock.getHandle(7) == "seven");
+        assert(arc.getHandle(7)->size() == 5);
+        assert(!clock.getHandle(8) && !arc.getHandle(8));
+        cout << "Passed." << endl;
+    }
+
+    cout << "All ValueHandle tests passed!" << endl;
+}
+
+// 记录拷贝次数的value，用来确认右值写入一路都是移动
+struct CopyCounter
+{
+    static int copies;
+    string payload;
+    CopyCounter() = default;
+    explicit CopyCounter(string p) : payload(std::move(p)) {}
+    CopyCounter(const CopyCounter &other) : payload(other.payload) { ++copies; }
+    CopyCounter(CopyCounter &&) = default;
+    CopyCounter &operator=(const CopyCounter &other)
+    {
+        payload = other.payload;
+        ++copies;
+        return *this;
+    }
+    CopyCounter &operator=(CopyCounter &&) = default;
+};
+int CopyCounter::copies = 0;
+
+void testMoveInsert()
+{
+    cout << "=== Testing Move Insert ===" << endl;
+
+    // 测试点 1: 右值put/emplace不拷贝value, tryEmplace遇到已有key不覆盖
+    {
+        cout << "[Test 1] Put Rvalue / Emplace / TryEmplace..." << endl;
+        LruCache<int, CopyCounter> lru(4);
+        LfuCache<int, CopyCounter> lfu(4, 10);
+        ArcCache<int, CopyCounter> arc(4, 2);
+        ClockProCache<int, CopyCounter> clockPro(4);
+        ShardedCache<int, CopyCounter, ArcCache<int, CopyCounter>> sharded(8, 2, 2);
+        vector<MeltiCache::ICachePolicy<int, CopyCounter> *> caches = {&lru, &lfu, &arc, &clockPro, &sharded};
+        for (auto *cache : caches)
+        {
+            CopyCounter::copies = 0;
+            cache->put(1, CopyCounter("one"));
+            cache->emplace(2, "two");
+            cache->put(1, CopyCounter("uno"));
+            assert(CopyCounter::copies == 0);
+            assert(cache->tryEmplace(3, "three"));
+            assert(!cache->tryEmplace(1, "ignored"));
+            assert(CopyCounter::copies == 0);
+            assert(cache->getHandle(1)->payload == "uno");
+            assert(cache->getHandle(2)->payload == "two");
+            assert(cache->getHandle(3)->payload == "three");
+        }
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: KLruCache 访问满k次才进入主缓存
+    {
+        cout << "[Test 2] KLru Admission..." << endl;
+        KLruCache<int, string> klru(2, 8, 2);
+        string val;
+        klru.put(1, "one");
+        assert(!klru.get(1, val));
+        klru.put(1, "one");
+        assert(klru.get(1, val) && val == "one");
+        klru.put(2, "two");
+        assert(klru.get(2) == "two");
+        assert(klru.get(2, val) && val == "two");
+        cout << "Passed." << endl;
+    }
+
+    cout << "All Move Insert tests passed!" << endl;
+}
+
+void testWeightedCapacity()
+{
+    cout << "=== Testing Weighted Capacity ===" << endl;
+    auto bytes = [](const int &, const string &value) { return value.size(); };
+
+    // 测试点 1: 按字节预算淘汰, 总权重不超过预算, 超过预算的单个条目不缓存
+    {
+        cout << "[Test 1] Byte Budget Eviction..." << endl;
+        LruCache<int, string> lru(100, bytes);
+        LfuCache<int, string> lfu(100, 10, bytes);
+        ArcCache<int, string> arc(100, 2, bytes);
+        vector<MeltiCache::ICachePolicy<int, string> *> caches = {&lru, &lfu, &arc};
+        for (auto *cache : caches)
+        {
+            for (int i = 0; i < 10; ++i)
+            {
+                cache->put(i, string(40, 'x'));
+                assert(cache->weightedSize() <= 200);  // ARC: LRU和LFU部分各100
+            }
+            cache->put(100, string(300, 'y'));
+            assert(!cache->getHandle(100));
+            cache->put(9, string(10, 'z'));  // 变轻后总权重同步减少
+            assert(cache->getHandle(9)->size() == 10);
+        }
+        assert(lru.weightedSize() == 50 && lfu.weightedSize() == 50);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 分片缓存汇总各分片的权重, 不配权重函数时就是条目数
+    {
+        cout << "[Test 2] Sharded Weighted Size..." << endl;
+        ShardedCache<int, string, LruCache<int, string>> weighted(400, 4, MeltiCache::Weigher<int, string>(bytes));
+        HashLruCache<int, string> counted(64, 4);
+        for (int i = 0; i < 16; ++i)
+        {
+            weighted.put(i, string(10, 'x'));
+            counted.put(i, string(10, 'x'));
+        }
+        assert(weighted.weightedSize() == 160);
+        assert(counted.weightedSize() == 16);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 3: 反复的幽灵命中只在LRU/LFU之间挪容量, 两部分之和不变;
+    // LFU容量被挪光后幽灵命中的key留在LRU, 读到要晋升时LFU放不下也不会丢
+    {
+        cout << "[Test 3] ARC Partition Stays Bounded..." << endl;
+        ArcCache<int, int> cache(100, 2);
+        int value = 0;
+        for (int pass = 0; pass < 3; ++pass)
+        {
+            for (int key = 0; key < 200; ++key)
+            {
+                if (!cache.get(key, value)) cache.put(key, key);
+            }
+        }
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            int hits = 0;
+            for (int key = 0; key < 200; ++key)
+            {
+                hits += cache.get(key, value) && value == key;
+            }
+            assert(hits == 200);
+        }
+        MeltiCache::CacheStatsSnapshot stats = cache.stats();
+        assert(stats.lruCapacity + stats.lfuCapacity == 200);
+        cout << "Passed." << endl;
+    }
+
+    cout << "All Weighted Capacity tests passed!" << endl;
+}
+
+void testExpiry()
+{
+    cout << "=== Testing Expiry ===" << endl;
+    using namespace std::chrono;
+
+    // 测试点 1: 单条ttl和写入后过期, 到期后读不到, cleanUp后权重被回收
+    auto writeTtl = [](auto &cache)
+    {
+        cache.put(1, string("short"), milliseconds(20));
+        cache.setExpireAfterWrite(seconds(10));
+        cache.put(2, string("long"));
+        string val;
+        assert(cache.get(1, val) && val == "short");
+        this_thread::sleep_for(milliseconds(40));
+        assert(!cache.get(1, val));
+        assert(cache.get(2, val) && val == "long");
+        cache.cleanUp();
+        assert(cache.weightedSize() == 1);
+    };
+    {
+        cout << "[Test 1] Per-entry TTL / Expire After Write..." << endl;
+        LruCache<int, string> lru(8);
+        LfuCache<int, string> lfu(8, 10);
+        ArcCache<int, string> arc(8, 3);
+        ShardedCache<int, string, ArcCache<int, string>> sharded(16, 2, 3);
+        writeTtl(lru);
+        writeTtl(lfu);
+        writeTtl(arc);
+        writeTtl(sharded);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 访问后过期, 持续访问的key一直在, 不访问的key到期被回收
+    auto accessTtl = [](auto &cache)
+    {
+        cache.setExpireAfterAccess(milliseconds(60));
+        cache.put(1, string("hot"));
+        cache.put(2, string("idle"));
+        string val;
+        for (int i = 0; i < 5; ++i)
+        {
+            this_thread::sleep_for(milliseconds(20));
+            assert(cache.get(1, val));
+            cache.cleanUp();  // ARC在维护时才重放读记录、顺延过期时间
+        }
+        assert(!cache.get(2, val));
+        assert(cache.weightedSize() == 1);
+    };
+    {
+        cout << "[Test 2] Expire After Access..." << endl;
+        LruCache<int, string> lru(8);
+        LfuCache<int, string> lfu(8, 10);
+        ArcCache<int, string> arc(8, 3);
+        accessTtl(lru);
+        accessTtl(lfu);
+        accessTtl(arc);
+        cout << "Passed." << endl;
+    }
+
+    cout << "All Expiry tests passed!" << endl;
+}
+
+void testTinyLfu()
+{
+    cout << "=== Testing TinyLfuCache ===" << endl;
+
+    // 测试点 1: 基本读写, 条目数不超过容量, 更新值生效
+    {
+        cout << "[Test 1] Basic Put/Get..." << endl;
+        TinyLfuCache<int, string> cache(100);
+        for (int i = 0; i < 100; ++i)
+        {
+            cache.put(i, "v" + to_string(i));
+        }
+        assert(cache.weightedSize() == 100);
+        assert(cache.get(42) == "v42");
+        cache.put(42, "new");
+        assert(cache.get(42) == "new");
+        for (int i = 1000; i < 1500; ++i)
+        {
+            cache.put(i, "x");
+            assert(cache.weightedSize() <= 100);
+        }
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 抗扫描, 一次性的key频率不够, 进不了主缓存, 热点数据留下 (同样的访问序列LRU会被冲光)
+    {
+        cout << "[Test 2] Scan Resistance..." << endl;
+        TinyLfuCache<int, string> tiny(100);
+        LruCache<int, string> lru(100);
+        vector<MeltiCache::ICachePolicy<int, string> *> caches = {&tiny, &lru};
+        for (auto *cache : caches)
+        {
+            for (int i = 0; i < 50; ++i)
+            {
+                cache->put(i, "hot");
+            }
+            for (int round = 0; round < 5; ++round)
+            {
+                for (int i = 0; i < 50; ++i)
+                {
+                    cache->get(i);
+                }
+            }
+            for (int i = 1000; i < 1500; ++i)
+            {
+                cache->put(i, "scan");
+            }
+        }
+        int tinyHits = 0;
+        int lruHits = 0;
+        string value;
+        for (int i = 0; i < 50; ++i)
+        {
+            tinyHits += tiny.get(i, value);
+            lruHits += lru.get(i, value);
+        }
+        assert(tinyHits >= 45);
+        assert(lruHits == 0);
+        cout << "Passed." << endl;
+    }
+
+    cout << "All TinyLfuCache tests passed!" << endl;
+}
+
+void testNodePool()
+{
+    cout << "=== Testing NodePool ===" << endl;
+
+    // 测试点 1: 淘汰释放的槽位马上被下一次插入复用, 满载持续换入换出池子也不再增长
+    {
+        cout << "[Test 1] Slots Reused After Eviction..." << endl;
+        MeltiCache::NodePool<int> pool(16);
+        vector<MeltiCache::SlotIndex> live;
+        for (int i = 0; i < 16; ++i)
+        {
+            live.push_back(pool.allocate());
+            pool[live.back()] = i;
+        }
+        assert(pool.capacity() == 16 && pool.inUse() == 16);
+        for (int i = 16; i < 10000; ++i)
+        {
+            MeltiCache::SlotIndex victim = live[i % 16];
+            pool.release(victim);
+            live[i % 16] = pool.allocate();
+            assert(live[i % 16] == victim);
+            pool[victim] = i;
+        }
+        assert(pool.capacity() == 16 && pool.inUse() == 16);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 池子按块扩容, 已有节点的地址不变
+    {
+        cout << "[Test 2] Growth Keeps Node Addresses..." << endl;
+        MeltiCache::NodePool<int> pool;
+        MeltiCache::SlotIndex first = pool.allocate();
+        int *address = &pool[first];
+        *address = 42;
+        for (int i = 0; i < 1000; ++i)
+        {
+            pool.allocate();
+        }
+        assert(pool.capacity() >= 1001 && pool.inUse() == 1001);
+        assert(&pool[first] == address && pool[first] == 42);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 3: 淘汰时槽位里的key和value立即释放, 不等槽位被复用
+    // 场景: 权重预算 10。写入 0 (权重1, 被跟踪) 和 1 (权重1), 再写入权重 10 的 2: 0 和 1 都被淘汰,
+    // 只有一个槽位被 2 复用, 0 的槽位空着, 它的value也必须已经释放
+    auto weight = [](const int &, const shared_ptr<int> &value) { return static_cast<size_t>(*value); };
+    auto evictTracked = [](auto &cache)
+    {
+        auto tracked = make_shared<int>(1);
+        cache.put(0, tracked);
+        cache.put(1, make_shared<int>(1));
+        assert(tracked.use_count() == 2);
+        cache.put(2, make_shared<int>(10));
+        shared_ptr<int> value;
+        assert(!cache.get(0, value) && !cache.get(1, value) && cache.get(2, value));
+        assert(tracked.use_count() == 1);
+    };
+    {
+        cout << "[Test 3] Evicted Values Freed At Once..." << endl;
+        LruCache<int, shared_ptr<int>> lru(10, weight);
+        LfuCache<int, shared_ptr<int>> lfu(10, 10, weight);
+        evictTracked(lru);
+        evictTracked(lfu);
+
+        // W-TinyLFU: 新key先进窗口, 下一次写把它当候选者挤出窗口, 频次不够被拒; 新节点先分配,
+        // 被拒的槽位要等再下一次写才复用
+        TinyLfuCache<int, shared_ptr<int>> tiny(8);
+        shared_ptr<int> value;
+        for (int i = 1; i <= 8; ++i)
+        {
+            tiny.put(i, make_shared<int>(i));
+            tiny.get(i, value);
+        }
+        auto tracked = make_shared<int>(0);
+        tiny.put(0, tracked);
+        tiny.put(9, make_shared<int>(9));
+        value.reset();
+        assert(!tiny.get(0, value));
+        assert(tracked.use_count() == 1);
+        cout << "Passed." << endl;
+    }
+
+    cout << "All NodePool tests passed!" << endl;
+}
+
+void testFlatIndex()
+{
+    cout << "=== Testing FlatIndex ===" << endl;
+    vector<int> keyOf(4096, -1);
+    auto findKey = [&](const MeltiCache::FlatIndex<int> &index, int key) {
+        return index.find(index.hash(key), [&](MeltiCache::SlotIndex slot) { return keyOf[slot] == key; });
+    };
+
+    // 测试点 1: 扩容只搬控制字节和槽位, 之后每个key都还能找到
+    {
+        cout << "[Test 1] Growth Keeps Entries..." << endl;
+        MeltiCache::FlatIndex<int> index;
+        for (int i = 0; i < 1000; ++i)
+        {
+            keyOf[i] = i * 64;  // 低位全相同的key
+            index.insert(index.hash(i * 64), i);
+        }
+        assert(index.size() == 1000);
+        for (int i = 0; i < 1000; ++i)
+        {
+            assert(findKey(index, i * 64) == static_cast<MeltiCache::SlotIndex>(i));
+        }
+        assert(findKey(index, 1) == MeltiCache::kNullSlot);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 边插边删(淘汰的模式), 删除不留墓碑, 探测链里后面的key依然可达
+    {
+        cout << "[Test 2] Erase Without Tombstones..." << endl;
+        MeltiCache::FlatIndex<int> index(64);
+        for (int i = 0; i < 4096; ++i)
+        {
+            keyOf[i] = i;
+            index.insert(index.hash(i), i);
+            if (i >= 64)
+            {
+                index.erase(index.hash(i - 64), i - 64);  // 只保留最近的64个
+            }
+        }
+        assert(index.size() == 64);
+        for (int i = 0; i < 4096; ++i)
+        {
+            assert((findKey(index, i) != MeltiCache::kNullSlot) == (i >= 4096 - 64));
+        }
+        cout << "Passed." << endl;
+    }
+
+    cout << "All FlatIndex tests passed!" << endl;
+}
+
+void testHasher()
+{
+    cout << "=== Testing Hasher ===" << endl;
+
+    // 测试点 1: string 和 string_view 哈希一致, 相近的短key结果不同
+    {
+        cout << "[Test 1] String Hash..." << endl;
+        MeltiCache::Hasher<string> hasher;
+        string text = "user:0000000000000000000000000000000000000000000000000000000042";
+        assert(hasher(text) == MeltiCache::Hasher<std::string_view>{}(std::string_view(text)));
+        assert(hasher("a") != hasher("b"));
+        assert(hasher("") != hasher(string(1, '\0')));
+        vector<uint64_t> seen;
+        for (int i = 0; i < 1000; ++i)
+        {
+            seen.push_back(hasher("key" + to_string(i)));
+        }
+        std::sort(seen.begin(), seen.end());
+        assert(std::unique(seen.begin(), seen.end()) == seen.end());
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 调用方算好的哈希经分片一路传到节点, 和普通 put/get 互通
+    {
+        cout << "[Test 2] Hash Once Through Shards..." << endl;
+        ShardedCache<string, int, ArcCache<string, int>> cache(256, 4, 2);
+        MeltiCache::Hasher<string> hasher;
+        for (int i = 0; i < 100; ++i)
+        {
+            string key = "k" + to_string(i);
+            if (i % 2) cache.putWithHash(key, hasher(key), i);
+            else cache.put(key, i);
+        }
+        int value = -1;
+        for (int i = 0; i < 100; ++i)
+        {
+            string key = "k" + to_string(i);
+            assert(cache.get(key, value) && value == i);
+            assert(cache.getWithHash(key, hasher(key), value) && value == i);
+        }
+        cout << "Passed." << endl;
+    }
+
+    cout << "All Hasher tests passed!" << endl;
+}
+
+void testCacheStats()
+{
+    cout << "=== Testing CacheStats ===" << endl;
+
+    // 测试点 1: ARC 的计数和幽灵命中后 LRU/LFU 容量的划分
+    // 场景: 容量 2。写入 1,2,3, 1 被淘汰进 LRU 幽灵表; 再写 1 命中幽灵表, LRU 容量 +1, LFU 容量 -1
+    {
+        cout << "[Test 1] ARC Counters And Partition..." << endl;
+        ArcCache<int, string> cache(2, 2);
+        cache.put(1, "one");
+        cache.put(2, "two");
+        cache.put(3, "three");
+        cache.put(1, "one");
+        string value;
+        assert(cache.get(1, value));
+        assert(!cache.get(9, value));
+        MeltiCache::CacheStatsSnapshot stats = cache.stats();
+#ifndef MELTICACHE_NO_STATS
+        assert(stats.puts == 4 && stats.hits == 1 && stats.misses == 1);
+        assert(stats.lruGhostHits == 1 && stats.lfuGhostHits == 0);
+#endif
+        assert(stats.lruEvictions == 1 && stats.lfuEvictions == 0 && stats.evictions == 1);
+        assert(stats.lruCapacity == 3 && stats.lfuCapacity == 1);
+        assert(stats.lruWeight == 2 && stats.lfuWeight == 1);
+        assert(stats.latencyCounts.empty());
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 分片汇总, 打开采样后每次读都计时, 直方图按桶合并
+    {
+        cout << "[Test 2] Sharded Snapshot With Latency..." << endl;
+        HashLruCache<int, string> cache(64, 4);
+        for (int i = 0; i < 100; ++i)
+        {
+            cache.put(i, to_string(i));
+        }
+        cache.setLatencySampling(1);
+        string value;
+        for (int i = 0; i < 1000; ++i)
+        {
+            cache.get(i % 200, value);
+        }
+#ifndef MELTICACHE_NO_STATS
+        MeltiCache::CacheStatsSnapshot stats = cache.stats();
+        uint64_t shardHits = 0;
+        for (size_t s = 0; s < cache.shardCount(); ++s)
+        {
+            shardHits += cache.shard(s).stats().hits;
+        }
+        assert(stats.hits == shardHits && stats.hits + stats.misses == 1000);
+        assert(stats.puts == 100 && stats.evictions == 100 - cache.weightedSize());
+        assert(stats.latencySamples() == 1000);
+        assert(stats.latencyPercentile(0.5) <= stats.latencyPercentile(0.99));
+        assert(stats.latencyPercentile(0.99) <= stats.latencyPercentile(0.999));
+#endif
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 3: 带 ttl 的写和普通写一样计时
+    auto timedTtlPuts = [](auto &cache)
+    {
+        cache.setLatencySampling(1);
+        for (int i = 0; i < 10; ++i)
+        {
+            cache.put(i, to_string(i), chrono::seconds(60));
+        }
+        string value = "moved";
+        cache.put(10, std::move(value), chrono::seconds(60));
+#ifndef MELTICACHE_NO_STATS
+        assert(cache.stats().latencySamples() == 11);
+#endif
+    };
+    {
+        cout << "[Test 3] Puts With A Time To Live Are Timed..." << endl;
+        ArcCache<int, string> arc(16, 2);
+        LruCache<int, string> lru(16);
+        LfuCache<int, string> lfu(16, 10);
+        timedTtlPuts(arc);
+        timedTtlPuts(lru);
+        timedTtlPuts(lfu);
+        MeltiCache::CacheBuilder<int, string>::Expiry<true>::Cache basic(16);
+        basic.setLatencySampling(1);
+        for (int i = 0; i < 10; ++i)
+        {
+            basic.put(i, to_string(i), chrono::seconds(60));
+        }
+#ifndef MELTICACHE_NO_STATS
+        assert(basic.stats().latencySamples() == 10);
+#endif
+        cout << "Passed." << endl;
+    }
+
+    cout << "All CacheStats tests passed!" << endl;
+}
+
+void testGetOrLoad()
+{
+    cout << "\n=== GetOrLoad Test ===" << endl;
+
+    // 测试点 1: 同一个key并发未命中, loader只跑一次, 所有线程拿到同一个结果
+    {
+        cout << "[Test 1] Concurrent Misses Share One Load..." << endl;
+        ArcCache<int, string> arc(8, 2);
+        HashLruCache<int, string> lru(64, 4);
+        vector<MeltiCache::ICachePolicy<int, string> *> caches{&arc, &lru};
+        for (MeltiCache::ICachePolicy<int, string> *cache : caches)
+        {
+            atomic<int> loads{0};
+            vector<string> results(16);
+            vector<thread> threads;
+            for (size_t t = 0; t < results.size(); ++t)
+            {
+                threads.emplace_back([&, t]() {
+                    results[t] = cache->getOrLoad(7, [&](const int &key) {
+                        ++loads;
+                        this_thread::sleep_for(chrono::milliseconds(50));
+                        return "v" + to_string(key);
+                    });
+                });
+            }
+            for (thread &th : threads)
+            {
+                th.join();
+            }
+            assert(loads == 1);
+            for (const string &result : results)
+            {
+                assert(result == "v7");
+            }
+            string value;
+            assert(cache->get(7, value) && value == "v7");
+            assert(cache->getOrLoad(7, [](const int &) -> string { throw runtime_error("cached"); }) == "v7");
+        }
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: loader抛异常时异常传给调用方, 缓存里不留条目, 下一次调用重新加载
+    {
+        cout << "[Test 2] Failed Load Does Not Poison..." << endl;
+        HashLruCache<int, string> cache(64, 4);
+        bool thrown = false;
+        try
+        {
+            cache.getOrLoad(3, [](const int &) -> string { throw runtime_error("backend down"); });
+        }
+        catch (const runtime_error &)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+        string value;
+        assert(!cache.get(3, value));
+        assert(cache.getOrLoad(3, [](const int &key) { return to_string(key * 2); }) == "6");
+        assert(cache.get(3, value) && value == "6");
+        cout << "Passed." << endl;
+    }
+
+    cout << "All GetOrLoad tests passed!" << endl;
+}
+
+void testRefreshAhead()
+{
+    cout << "\n=== Refresh-Ahead Test ===" << endl;
+
+    // 测试点 1: 超过刷新时间的命中立刻返回旧值, 后台重新加载后换成新值
+    {
+        cout << "[Test 1] Stale Hit Returns Old Value And Reloads..." << endl;
+        MeltiCache::Executor executor(1);
+        atomic<int> loads{0};
+        ArcCache<int, string> cache(8, 2);
+        cache.setLoader([&](const int &key) { return to_string(key) + "v" + to_string(++loads); }, executor);
+        cache.setRefreshAfterWrite(chrono::milliseconds(20));
+        cache.put(1, "old");
+        string value;
+        assert(cache.get(1, value) && value == "old" && loads == 0);
+        this_thread::sleep_for(chrono::milliseconds(30));
+        assert(cache.get(1, value) && value == "old");
+        for (int i = 0; i < 200 && value != "1v1"; ++i)
+        {
+            this_thread::sleep_for(chrono::milliseconds(5));
+            cache.get(1, value);
+        }
+        assert(value == "1v1" && loads == 1);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 并发的过期命中只调度一次加载, 加载失败保留旧值, 加载期间被重写的值不会被覆盖
+    {
+        cout << "[Test 2] One Reload Per Key, Failures Keep Old Value..." << endl;
+        MeltiCache::Executor executor(2);
+        atomic<int> loads{0};
+        ArcCache<int, string> cache(8, 2);
+        cache.setLoader(
+            [&](const int &key) -> string
+            {
+                ++loads;
+                this_thread::sleep_for(chrono::milliseconds(30));
+                if (key == 2) throw runtime_error("backend down");
+                return "reloaded";
+            },
+            executor);
+        cache.setRefreshAfterWrite(chrono::milliseconds(1));
+        cache.put(2, "kept");
+        cache.put(3, "old");
+        this_thread::sleep_for(chrono::milliseconds(5));
+        string value;
+        for (int i = 0; i < 10; ++i)
+        {
+            assert(cache.get(2, value) && value == "kept");
+            assert(cache.get(3, value));
+        }
+        cache.put(3, "rewritten");
+        this_thread::sleep_for(chrono::milliseconds(100));
+        assert(loads == 2);
+        assert(cache.get(2, value) && value == "kept");
+        assert(cache.get(3, value) && value == "rewritten");
+        cout << "Passed." << endl;
+    }
+
+    cout << "All Refresh-Ahead tests passed!" << endl;
+}
+
+void testSnapshot()
+{
+    cout << "\n=== Snapshot Test ===" << endl;
+    const string path = "/tmp/melticache_test.snapshot";
+
+    // 测试点 1: 快照恢复后条目、LRU/LFU划分和幽灵列表都一致, 之后同样的操作得到同样的结果
+    {
+        cout << "[Test 1] ARC State Round Trip..." << endl;
+        ArcCache<int, string> cache(3, 2);
+        cache.put(1, "a");
+        cache.put(2, "b");
+        cache.put(3, "c");
+        string value;
+        assert(cache.get(1, value));
+        cache.put(4, "d");  // 2 goes to the LRU ghost
+        cache.put(2, "b");  // ghost hit: the LRU part grows
+        assert(cache.snapshot(path));
+
+        ArcCache<int, string> restored(3, 2, path);
+        MeltiCache::CacheStatsSnapshot before = cache.stats();
+        MeltiCache::CacheStatsSnapshot after = restored.stats();
+        assert(before.lruCapacity == after.lruCapacity && before.lfuCapacity == after.lfuCapacity);
+        assert(before.lruWeight == after.lruWeight && before.lfuWeight == after.lfuWeight);
+        for (int key : {5, 3, 6, 1})
+        {
+            cache.put(key, to_string(key));
+            restored.put(key, to_string(key));
+        }
+        for (int key = 1; key <= 6; ++key)
+        {
+            string expected;
+            string actual;
+            bool hit = cache.get(key, expected);
+            assert(restored.get(key, actual) == hit && actual == expected);
+        }
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 分片缓存逐分片写出和读回, 分片数不同或文件损坏时拒绝
+    {
+        cout << "[Test 2] Sharded Round Trip And Damaged Files..." << endl;
+        ShardedCache<int, string, ArcCache<int, string>> cache(64, 4, 2);
+        for (int i = 0; i < 40; ++i)
+        {
+            cache.put(i, to_string(i));
+        }
+        assert(cache.snapshot(path));
+        ShardedCache<int, string, ArcCache<int, string>> restored(64, 4, 2);
+        assert(restored.load(path));
+        string value;
+        for (int i = 0; i < 40; ++i)
+        {
+            assert(restored.get(i, value) && value == to_string(i));
+        }
+        ShardedCache<int, string, ArcCache<int, string>> resharded(64, 8, 2);
+        assert(!resharded.load(path));
+        assert(!restored.load(path + ".missing"));
+
+        FILE *file = fopen(path.c_str(), "r+b");
+        assert(file != nullptr);
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fclose(file);
+        assert(truncate(path.c_str(), size / 2) == 0);
+        ShardedCache<int, string, ArcCache<int, string>> partial(64, 4, 2);
+        assert(!partial.load(path));
+        assert(partial.weightedSize() < 40);
+        remove(path.c_str());
+        cout << "Passed." << endl;
+    }
+
+    cout << "All Snapshot tests passed!" << endl;
+}
+
+void testCacheBuilder()
+{
+    cout << "\n=== CacheBuilder Test ===" << endl;
+
+    // 测试点 1: 单线程配置: 无锁、无统计、无过期, LRU淘汰最久未用的条目
+    {
+        cout << "[Test 1] Single-Threaded LRU..." << endl;
+        using Cache = MeltiCache::CacheBuilder<int, string>::Lock<MeltiCache::NoLock>::Stats<false>::Cache;
+        static_assert(is_same<Cache::Lock, MeltiCache::NoLock>::value, "lock policy");
+        static_assert(!Cache::kStats && !Cache::kExpiry, "stats and expiry off");
+        Cache cache(2);
+        cache.put(1, "one");
+        cache.put(2, "two");
+        string value;
+        assert(cache.get(1, value) && value == "one");
+        cache.put(3, "three");
+        assert(!cache.get(2, value));
+        assert(cache.get(1, value) && cache.get(3, value) && cache.size() == 2);
+        assert(cache.remove(1) && !cache.get(1, value) && cache.size() == 1);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: CLOCK + 读写锁 + 统计 + 过期, 通过ICachePolicy适配器使用
+    {
+        cout << "[Test 2] Clock With Expiry Behind ICachePolicy..." << endl;
+        using Builder = MeltiCache::CacheBuilder<int, string>::Lock<shared_mutex>::Eviction<
+            MeltiCache::ClockEviction>::Expiry<true>;
+        Builder::Policy policy(3);
+        MeltiCache::ICachePolicy<int, string> &cache = policy;
+        cache.put(1, "one");
+        cache.put(2, "two");
+        cache.put(3, "three");
+        string value;
+        assert(cache.get(1, value) && cache.get(3, value));
+        cache.put(4, "four");  // 2 is the only unreferenced entry
+        assert(!cache.get(2, value) && cache.get(1, value) && cache.get(4, value));
+        policy.cache().put(5, "five", chrono::milliseconds(20));
+        assert(cache.get(5, value) && value == "five");
+        this_thread::sleep_for(chrono::milliseconds(40));
+        assert(!cache.get(5, value));
+#ifndef MELTICACHE_NO_STATS
+        MeltiCache::CacheStatsSnapshot stats = policy.cache().stats();
+        assert(stats.puts == 5 && stats.evictions == 2 && stats.misses == 2);
+#endif
+        cout << "Passed." << endl;
+    }
+
+    cout << "All CacheBuilder tests passed!" << endl;
+}
+
+void testLirs()
+{
+    cout << "\n=== LirsCache Test ===" << endl;
+
+    // 测试点 1: 比容量稍大的循环访问, LRU每次都未命中, LIRS让大部分key常驻
+    {
+        cout << "[Test 1] Loop Larger Than Capacity..." << endl;
+        LirsCache<int, int> lirs(100);
+        LruCache<int, int> lru(100);
+        size_t lirsHits = 0, lruHits = 0, requests = 0;
+        for (int pass = 0; pass < 20; ++pass)
+        {
+            for (int key = 0; key < 110; ++key, ++requests)
+            {
+                int value = 0;
+                if (lirs.get(key, value)) ++lirsHits;
+                else lirs.put(key, key);
+                if (lru.get(key, value)) ++lruHits;
+                else lru.put(key, key);
+            }
+        }
+        assert(lruHits == 0);
+        assert(lirsHits > requests * 8 / 10);
+        assert(lirs.weightedSize() == 100);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 还在栈里的非驻留key再次写入时变成LIR, 挤掉最旧的LIR而不是最近写入的key
+    {
+        cout << "[Test 2] Non-Resident Key Promotion..." << endl;
+        LirsCache<int, string> cache(3);  // 2 LIR + 1 resident HIR
+        cache.put(1, "one");
+        cache.put(2, "two");
+        cache.put(3, "three");
+        cache.put(4, "four");  // 3 becomes non-resident
+        string value;
+        assert(!cache.get(3, value));
+        cache.put(3, "three");  // 3 -> LIR, 1 demoted to HIR, 4 becomes non-resident
+        assert(cache.get(1, value) && value == "one");
+        assert(cache.get(2, value) && cache.get(3, value) && value == "three");
+        assert(!cache.get(4, value));
+        assert(!cache.insertIfAbsent(2, []() { return string("x"); }));
+        assert(cache.weightedSize() == 3);
+        cout << "Passed." << endl;
+    }
+
+    cout << "All LirsCache tests passed!" << endl;
+}
+
+void testS3Fifo()
+{
+    cout << "\n=== S3FifoCache Test ===" << endl;
+
+    // 测试点 1: 小队列里被命中过的key进入主队列, 之后的一次性扫描只在小队列里淘汰
+    {
+        cout << "[Test 1] Scan Resistance..." << endl;
+        S3FifoCache<int, int> cache(10);
+        LruCache<int, int> lru(10);
+        int value = 0;
+        for (int key = 0; key < 5; ++key)
+        {
+            cache.put(key, key);
+            lru.put(key, key);
+            assert(cache.get(key, value) && lru.get(key, value));
+        }
+        for (int key = 100; key < 200; ++key)
+        {
+            cache.put(key, key);
+            lru.put(key, key);
+        }
+        for (int key = 0; key < 5; ++key)
+        {
+            assert(cache.get(key, value) && value == key);
+            assert(!lru.get(key, value));
+        }
+        assert(cache.weightedSize() == 10);
+        cout << "Passed." << endl;
+    }
+
+    // 测试点 2: 多线程读写, 值不串, 条目数不超过容量; 被淘汰后很快回来的key经幽灵队列直接进主队列
+    {
+        cout << "[Test 2] Concurrent Access And Ghost Readmission..." << endl;
+        S3FifoCache<int, string> cache(256);
+        vector<thread> threads;
+        for (int t = 0; t < 8; ++t)
+        {
+            threads.emplace_back([&cache, t]() {
+                for (int i = 0; i < 20000; ++i)
+                {
+                    int key = (i * 7 + t * 13) % 1024;
+                    string value;
+                    if (cache.get(key, value))
+                        assert(value == to_string(key));
+                    else
+                        cache.put(key, to_string(key));
+                }
+            });
+        }
+        for (thread &worker : threads)
+        {
+            worker.join();
+        }
+        assert(cache.weightedSize() <= 256);
+
+        S3FifoCache<int, string> ghost(10);
+        ghost.put(1, "one");
+        for (int key = 100; key < 111; ++key)
+        {
+            ghost.put(key, "scan");
+        }
+        string value;
+        assert(!ghost.get(1, value));
+        ghost.put(1, "one");  // still a ghost: goes to the main queue
+        for (int key = 200; key < 300; ++key)
+        {
+            ghost.put(key, "scan");
+        }
+        assert(ghost.get(1, value) && value == "one");
+        cout << "Passed." << endl;
+    }
+
+    cout << "All S3FifoCache tests passed!" << endl;
+}
+
 int main()
 {
-    // testArcLfu();
+    testArcLfu();
     testArcCache();
+    testLfuCache();
+    testShardedCache();
+    testClockCache();
+    testValueHandle();
+    testMoveInsert();
+    testWeightedCapacity();
+    testExpiry();
+    testTinyLfu();
+    testNodePool();
+    testFlatIndex();
+    testHasher();
+    testCacheStats();
+    testGetOrLoad();
+    testRefreshAhead();
+    testSnapshot();
+    testCacheBuilder();
+    testLirs();
+    testS3Fifo();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "NodePool.h"
+
+namespace MeltiCache
+{
+    // Hierarchical timing wheel over pool slots (Varghese & Lauck). Each level has 64 buckets; a level-0
+    // tick is 2^20 ns (~1 ms) and every level up is 64 times coarser, so five levels cover about 13 days
+    // and anything later waits in the top level and is cascaded down when its bucket comes round.
+    // Timers are kept in a per-slot side table (deadline plus bucket links), so the cache nodes carry no
+    // time field and a cache that never uses expiry never allocates the table.
+    // schedule/deschedule are O(1); advance() touches only the buckets whose ticks have passed.
+    // Not thread safe: callers hold the cache's exclusive lock.
+    class TimerWheel
+    {
+      public:
+        using Duration = std::chrono::nanoseconds;
+
+        // the cache's clock, read at most once per operation
+        static uint64_t now()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<Duration>(
+                                             std::chrono::steady_clock::now().time_since_epoch())
+                                             .count());
+        }
+
+        TimerWheel() : time_(now()), size_(0)
+        {
+            for (SlotIndex &head : buckets_)
+            {
+                head = kNullSlot;
+            }
+        }
+
+        // (re)arms the slot's timer, a deadline of 0 disarms it
+        void schedule(SlotIndex slot, uint64_t deadline)
+        {
+            deschedule(slot);
+            if (deadline == 0) return;
+            if (slot >= timers_.size())
+            {
+                timers_.resize(slot + 1);
+            }
+            timers_[slot].deadline = deadline;
+            link(slot);
+            ++size_;
+        }
+
+        void deschedule(SlotIndex slot)
+        {
+            if (slot >= timers_.size() || timers_[slot].deadline == 0) return;
+            unlink(slot);
+            timers_[slot].deadline = 0;
+            --size_;
+        }
+
+        // 0 when the slot has no timer
+        uint64_t deadlineOf(SlotIndex slot) const { return slot < timers_.size() ? timers_[slot].deadline : 0; }
+
+        bool expired(SlotIndex slot, uint64_t now) const
+        {
+            uint64_t deadline = deadlineOf(slot);
+            return deadline != 0 && deadline <= now;
+        }
+
+        // Moves the wheel to now and calls expire(slot) for every timer that is due; the timer is already
+        // disarmed when expire runs. Timers in a passed bucket that are not due yet cascade to a finer level.
+        template <typename Expire>
+        void advance(uint64_t now, Expire &&expire)
+        {
+            if (size_ == 0 || now < time_)
+            {
+                time_ = now > time_ ? now : time_;
+                return;
+            }
+            uint64_t previous = time_;
+            time_ = now;
+            for (unsigned level = 0; level < kLevels; ++level)
+            {
+                uint64_t prevTicks = previous >> kShift[level];
+                uint64_t curTicks = now >> kShift[level];
+                // level 0 always revisits the current bucket, it may hold timers that came due within the tick
+                if (level > 0 && prevTicks == curTicks) break;
+                uint64_t count = curTicks - prevTicks + 1;
+                if (count > kBuckets) count = kBuckets;
+                for (uint64_t tick = prevTicks; tick < prevTicks + count; ++tick)
+                {
+                    expireBucket(level * kBuckets + (tick & (kBuckets - 1)), now, expire);
+                }
+            }
+        }
+
+        size_t size() const { return size_; }
+
+      private:
+        static constexpr unsigned kLevels = 5;
+        static constexpr unsigned kBuckets = 64;
+        static constexpr unsigned kShift[kLevels + 1] = {20, 26, 32, 38, 44, 50};
+
+        struct Timer
+        {
+            uint64_t deadline = 0;
+            SlotIndex prev = kNullSlot;
+            SlotIndex next = kNullSlot;
+            uint32_t bucket = 0;
+        };
+
+        uint32_t bucketFor(uint64_t deadline) const
+        {
+            uint64_t delta = deadline > time_ ? deadline - time_ : 0;
+            unsigned level = 0;
+            while (level + 1 < kLevels && delta >= (uint64_t(1) << kShift[level + 1]))
+            {
+                ++level;
+            }
+            // due timers go to the current level-0 bucket and fire on the next advance
+            uint64_t tick = (deadline > time_ ? deadline : time_) >> kShift[level];
+            return static_cast<uint32_t>(level * kBuckets + (tick & (kBuckets - 1)));
+        }
+
+        void link(SlotIndex slot)
+        {
+            Timer &timer = timers_[slot];
+            timer.bucket = bucketFor(timer.deadline);
+            timer.prev = kNullSlot;
+            timer.next = buckets_[timer.bucket];
+            if (timer.next != kNullSlot) timers_[timer.next].prev = slot;
+            buckets_[timer.bucket] = slot;
+        }
+
+        void unlink(SlotIndex slot)
+        {
+            Timer &timer = timers_[slot];
+            if (timer.prev != kNullSlot)
+                timers_[timer.prev].next = timer.next;
+            else
+                buckets_[timer.bucket] = timer.next;
+            if (timer.next != kNullSlot) timers_[timer.next].prev = timer.prev;
+            timer.prev = timer.next = kNullSlot;
+        }
+
+        template <typename Expire>
+        void expireBucket(uint32_t bucket, uint64_t now, Expire &expire)
+        {
+            // detach the whole chain first so cascaded timers can land in this bucket again
+            SlotIndex slot = buckets_[bucket];
+            buckets_[bucket] = kNullSlot;
+            while (slot != kNullSlot)
+            {
+                Timer &timer = timers_[slot];
+                SlotIndex next = timer.next;
+                timer.prev = timer.next = kNullSlot;
+                if (timer.deadline <= now)
+                {
+                    timer.deadline = 0;
+                    --size_;
+                    expire(slot);
+                }
+                else
+                {
+                    link(slot);
+                }
+                slot = next;
+            }
+        }
+
+        uint64_t time_;  // the wheel's current time, ns
+        size_t size_;    // armed timers
+        SlotIndex buckets_[kLevels * kBuckets];
+        std::vector<Timer> timers_;  // indexed by slot, grown on first schedule of a slot
+    };
+}  // namespace MeltiCache
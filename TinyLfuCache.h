@@ -0,0 +1,326 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+#include "FlatIndex.h"
+#include "FrequencySketch.h"
+#include "ICachePolicy.h"
+#include "NodePool.h"
+
+// W-TinyLFU (Einziger, Friedman, Manes, ACM ToS 2017). New entries land in a small window LRU; the window's
+// victim then competes with the main cache's victim and only the one the frequency sketch has seen more often
+// stays. The main cache is a segmented LRU: a first hit in probation promotes the entry to protected, and
+// protected overflow is demoted back to probation. Admission history costs one sketch word per entry instead
+// of KLruCache's full history cache, and keys that were never admitted keep no value.
+// Every get (hit or miss) and put counts towards the sketch, so a key that keeps missing earns its way in.
+template <typename Key, typename Value>
+class TinyLfuCache : public MeltiCache::ICachePolicy<Key, Value>
+{
+  private:
+    enum class Segment : uint8_t
+    {
+        Window,
+        Probation,
+        Protected
+    };
+
+    struct Node
+    {
+        Key key_;
+        Value value_;
+        Segment segment_ = Segment::Window;
+        uint64_t hash_ = 0;  // Hasher<Key> hash, reused by the sketch and the index at eviction
+        MeltiCache::SlotIndex pre_ = MeltiCache::kNullSlot;
+        MeltiCache::SlotIndex next_ = MeltiCache::kNullSlot;
+    };
+
+    using NodePool = MeltiCache::NodePool<Node>;
+    using Slot = MeltiCache::SlotIndex;
+
+  public:
+    // windowPercent of the capacity (at least one entry) goes to the window, the rest is the main cache,
+    // of which 80% is protected
+    TinyLfuCache(int capacity, int windowPercent = 1)
+        : capacity_(capacity > 0 ? capacity : 0),
+          windowSize_(0),
+          probationSize_(0),
+          protectedSize_(0),
+          pool_(capacity_ + 3),
+          sketch_(capacity_)
+    {
+        windowCapacity_ = capacity_ * static_cast<size_t>(windowPercent > 0 ? windowPercent : 0) / 100;
+        if (windowCapacity_ == 0) windowCapacity_ = 1;
+        if (windowCapacity_ > capacity_) windowCapacity_ = capacity_;
+        mainCapacity_ = capacity_ - windowCapacity_;
+        protectedCapacity_ = mainCapacity_ * 8 / 10;
+        for (Slot& head : heads_)
+        {
+            head = pool_.allocate();
+            pool_[head].pre_ = pool_[head].next_ = head;
+        }
+        map_.reserve(capacity_);
+    }
+
+    void put(const Key& key, const Value& value) override { TinyLfuCache::putWithHash(key, map_.hash(key), value); }
+
+    // one hash per operation serves the sketch and the index
+    void putWithHash(const Key& key, uint64_t hash, const Value& value) override
+    {
+        if (capacity_ == 0) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        putImpl(key, value, hash);
+    }
+
+    void put(Key&& key, Value&& value) override
+    {
+        uint64_t hash = map_.hash(key);
+        TinyLfuCache::putWithHash(std::move(key), hash, std::move(value));
+    }
+
+    void putWithHash(Key&& key, uint64_t hash, Value&& value) override
+    {
+        if (capacity_ == 0) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        putImpl(std::move(key), std::move(value), hash);
+    }
+
+    bool insertIfAbsent(const Key& key, const std::function<Value()>& makeValue) override
+    {
+        return TinyLfuCache::insertIfAbsentWithHash(key, map_.hash(key), makeValue);
+    }
+
+    bool insertIfAbsentWithHash(const Key& key, uint64_t hash, const std::function<Value()>& makeValue) override
+    {
+        if (capacity_ == 0) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (findSlot(key, hash) != MeltiCache::kNullSlot) return false;
+        sketch_.incrementHash(hash);
+        insertNew(key, makeValue(), hash);
+        return true;
+    }
+
+    bool get(const Key& key, Value& value) override { return TinyLfuCache::getWithHash(key, map_.hash(key), value); }
+
+    bool getWithHash(const Key& key, uint64_t hash, Value& value) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sketch_.incrementHash(hash);
+        Slot slot = findSlot(key, hash);
+        if (slot == MeltiCache::kNullSlot) return false;
+        onHit(slot);
+        value = pool_[slot].value_;
+        return true;
+    }
+
+    Value get(const Key& key) override
+    {
+        Value value{};
+        get(key, value);
+        return value;
+    }
+
+    MeltiCache::ValueHandle<Value> getHandle(const Key& key) override
+    {
+        return TinyLfuCache::getHandleWithHash(key, map_.hash(key));
+    }
+
+    MeltiCache::ValueHandle<Value> getHandleWithHash(const Key& key, uint64_t hash) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sketch_.incrementHash(hash);
+        Slot slot = findSlot(key, hash);
+        if (slot == MeltiCache::kNullSlot) return MeltiCache::ValueHandle<Value>();
+        onHit(slot);
+        return MeltiCache::ValueHandle<Value>(&pool_[slot].value_, &pool_.pins(slot));
+    }
+
+    // no weigher, every entry weighs 1
+    size_t weightedSize() override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return map_.size();
+    }
+
+  private:
+    Slot findSlot(const Key& key, uint64_t hash) const
+    {
+        return map_.find(hash, [&](Slot slot) { return pool_[slot].key_ == key; });
+    }
+
+    template <typename K, typename V>
+    void putImpl(K&& key, V&& value, uint64_t hash)
+    {
+        sketch_.incrementHash(hash);
+        Slot node = findSlot(key, hash);
+        if (node != MeltiCache::kNullSlot)
+        {
+            if (pool_.isPinned(node))
+            {
+                node = replacePinnedNode(node);
+            }
+            pool_[node].value_ = std::forward<V>(value);
+            onHit(node);
+            return;
+        }
+        insertNew(std::forward<K>(key), std::forward<V>(value), hash);
+    }
+
+    template <typename K, typename V>
+    void insertNew(K&& key, V&& value, uint64_t hash)
+    {
+        Slot slot = pool_.allocate();
+        Node& node = pool_[slot];
+        map_.insert(hash, slot);
+        node.hash_ = hash;
+        node.key_ = std::forward<K>(key);
+        node.value_ = std::forward<V>(value);
+        node.segment_ = Segment::Window;
+        linkFront(slot);
+        if (++windowSize_ > windowCapacity_)
+        {
+            evictFromWindow();
+        }
+    }
+
+    // The window's LRU entry is the admission candidate. While the main cache has room it goes straight to
+    // probation, otherwise it must be seen more often than the main cache's victim to replace it.
+    void evictFromWindow()
+    {
+        Slot candidate = pool_[head(Segment::Window)].pre_;
+        unlink(candidate);
+        --windowSize_;
+        if (probationSize_ + protectedSize_ < mainCapacity_)
+        {
+            moveTo(candidate, Segment::Probation);
+            return;
+        }
+        Slot victim = pool_[head(Segment::Probation)].pre_;
+        if (victim == head(Segment::Probation))
+        {
+            victim = pool_[head(Segment::Protected)].pre_;
+        }
+        if (victim == head(Segment::Protected) ||
+            sketch_.frequencyHash(pool_[candidate].hash_) <= sketch_.frequencyHash(pool_[victim].hash_))
+        {
+            // ties go to the victim, a one-off key must not displace an entry of equal standing
+            evict(candidate);
+            return;
+        }
+        unlink(victim);
+        --sizeOf(pool_[victim].segment_);
+        evict(victim);
+        moveTo(candidate, Segment::Probation);
+    }
+
+    void onHit(Slot slot)
+    {
+        switch (pool_[slot].segment_)
+        {
+            case Segment::Window:
+            case Segment::Protected:
+                unlink(slot);
+                linkFront(slot);
+                break;
+            case Segment::Probation:
+                unlink(slot);
+                --probationSize_;
+                moveTo(slot, Segment::Protected);
+                // protected overflow goes back to probation, where it competes with new candidates again
+                while (protectedSize_ > protectedCapacity_)
+                {
+                    Slot demoted = pool_[head(Segment::Protected)].pre_;
+                    unlink(demoted);
+                    --protectedSize_;
+                    moveTo(demoted, Segment::Probation);
+                }
+                break;
+        }
+    }
+
+    // A handle still reads the old value: put a fresh node in its place instead of overwriting it.
+    Slot replacePinnedNode(Slot old)
+    {
+        Slot slot = pool_.allocate();
+        Node& cur = pool_[slot];
+        Node& prev = pool_[old];
+        cur.key_ = prev.key_;
+        cur.segment_ = prev.segment_;
+        cur.hash_ = prev.hash_;
+        cur.pre_ = prev.pre_;
+        cur.next_ = prev.next_;
+        pool_[cur.pre_].next_ = slot;
+        pool_[cur.next_].pre_ = slot;
+        prev.pre_ = prev.next_ = MeltiCache::kNullSlot;
+        map_.replace(cur.hash_, old, slot);
+        releaseNode(old);
+        return slot;
+    }
+
+    // the slot is already unlinked and its segment count already dropped
+    void evict(Slot slot)
+    {
+        map_.erase(pool_[slot].hash_, slot);
+        releaseNode(slot);
+    }
+
+    // the value is freed now rather than when the slot is reused, unless a handle still reads it
+    void releaseNode(Slot slot)
+    {
+        if (!pool_.isPinned(slot))
+        {
+            pool_[slot].key_ = Key();
+            pool_[slot].value_ = Value();
+        }
+        pool_.release(slot);
+    }
+
+    void moveTo(Slot slot, Segment segment)
+    {
+        pool_[slot].segment_ = segment;
+        ++sizeOf(segment);
+        linkFront(slot);
+    }
+
+    Slot head(Segment segment) const { return heads_[static_cast<size_t>(segment)]; }
+
+    size_t& sizeOf(Segment segment)
+    {
+        return segment == Segment::Window ? windowSize_ : segment == Segment::Probation ? probationSize_ : protectedSize_;
+    }
+
+    // after the head of the node's own segment, i.e. most recent
+    void linkFront(Slot slot)
+    {
+        Slot first = head(pool_[slot].segment_);
+        Node& node = pool_[slot];
+        node.pre_ = first;
+        node.next_ = pool_[first].next_;
+        pool_[node.next_].pre_ = slot;
+        pool_[first].next_ = slot;
+    }
+
+    void unlink(Slot slot)
+    {
+        Node& node = pool_[slot];
+        pool_[node.pre_].next_ = node.next_;
+        pool_[node.next_].pre_ = node.pre_;
+        node.pre_ = node.next_ = MeltiCache::kNullSlot;
+    }
+
+  private:
+    size_t capacity_;
+    size_t windowCapacity_;
+    size_t mainCapacity_;       // probation + protected
+    size_t protectedCapacity_;  // probation takes whatever protected leaves
+    size_t windowSize_;
+    size_t probationSize_;
+    size_t protectedSize_;
+    NodePool pool_;   // entries plus one circular-list sentinel per segment
+    Slot heads_[3];   // sentinels, next_ is the most recent entry and pre_ the least recent
+    MeltiCache::FlatIndex<Key> map_;
+    MeltiCache::FrequencySketch<Key> sketch_;
+    std::mutex mutex_;
+};
@@ -0,0 +1,388 @@
+// Trace-driven hit-ratio simulator.
+//
+//   g++ -std=c++17 -O2 -DNDEBUG TraceReplay.cc -o replay -pthread
+//   ./replay --trace=OLTP.lis --format=arc --policies=lru,arc --sizes=1000,5000,10000 --transform-need=2,4
+//
+// The trace is memory-mapped once and every (policy, size) job streams it straight from the mapping on its
+// own thread, so N jobs replay in parallel with no copy of the trace and no allocation per request. Each
+// request is a read-through access: get, and put on a miss. Output is one line per job (CSV with a header
+// or JSON lines): the hit ratio of each cache size, i.e. the hit-ratio curve of each policy. A size is the
+// number of entries the cache may hold, for every policy; ArcCache is built with half of it, since its LRU and
+// LFU parts each get the capacity it is constructed with.
+//
+// Trace formats:
+//   arc      ARC traces (Megiddo & Modha): "start_block block_count ignored request_id" per line, every line
+//            accesses block_count consecutive blocks
+//   lirs     LIRS traces: one block number per line, lines that do not start with a digit are skipped
+//   twitter  Twitter cache traces (Yang et al., OSDI 2020): "timestamp,key,key_size,value_size,client,op,ttl",
+//            the key string is hashed to 64 bits
+//   bin      raw little-endian uint64 keys
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ArcCache.h"
+#include "ClockCache.h"
+#include "Hasher.h"
+#include "LFUCache.h"
+#include "LRUCache.h"
+#include "LirsCache.h"
+#include "S3FifoCache.h"
+#include "TinyLfuCache.h"
+
+using namespace std;
+
+namespace
+{
+    using Key = uint64_t;
+    using Value = uint32_t;  // the simulation only counts hits, values are never read
+    using Cache = MeltiCache::ICachePolicy<Key, Value>;
+
+    struct Options
+    {
+        string trace;
+        string format = "lirs";
+        vector<string> policies{"arc"};
+        vector<size_t> sizes;
+        vector<size_t> transformNeeds{2};  // ArcCache only
+        size_t threads = 0;  // 0: one per core
+        uint64_t limit = 0;  // 0: whole trace
+        string output = "csv";
+    };
+
+    // read-only mapping of the whole trace file
+    class MappedFile
+    {
+      public:
+        explicit MappedFile(const string &path)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                fprintf(stderr, "cannot open %s: %s\n", path.c_str(), strerror(errno));
+                exit(1);
+            }
+            struct stat st;
+            if (::fstat(fd, &st) != 0)
+            {
+                fprintf(stderr, "cannot stat %s: %s\n", path.c_str(), strerror(errno));
+                exit(1);
+            }
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ > 0)
+            {
+                void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data == MAP_FAILED)
+                {
+                    fprintf(stderr, "cannot map %s: %s\n", path.c_str(), strerror(errno));
+                    exit(1);
+                }
+                // every job reads front to back: let the kernel read ahead aggressively
+                ::madvise(data, size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const char *>(data);
+            }
+            ::close(fd);
+        }
+
+        ~MappedFile()
+        {
+            if (data_) ::munmap(const_cast<char *>(data_), size_);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const char *begin() const { return data_; }
+        const char *end() const { return data_ + size_; }
+        size_t size() const { return size_; }
+
+      private:
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    const char *skipBlanks(const char *p, const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    const char *nextLine(const char *p, const char *end)
+    {
+        const void *newline = memchr(p, '\n', static_cast<size_t>(end - p));
+        return newline ? static_cast<const char *>(newline) + 1 : end;
+    }
+
+    // parses an unsigned decimal at p, returns the position after it (p itself when there is no digit)
+    const char *parseNumber(const char *p, const char *end, uint64_t &value)
+    {
+        value = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            value = value * 10 + static_cast<uint64_t>(*p - '0');
+            ++p;
+        }
+        return p;
+    }
+
+    // Calls access(key) for every request of the trace until it returns false. Parses in place, no allocation.
+    template <typename Access>
+    void forEachRequest(const MappedFile &file, const string &format, Access &&access)
+    {
+        const char *p = file.begin();
+        const char *end = file.end();
+        if (format == "bin")
+        {
+            for (; p + sizeof(Key) <= end; p += sizeof(Key))
+            {
+                Key key;
+                memcpy(&key, p, sizeof(Key));
+                if (!access(key)) return;
+            }
+        }
+        else if (format == "lirs")
+        {
+            for (; p < end; p = nextLine(p, end))
+            {
+                uint64_t block;
+                const char *q = skipBlanks(p, end);
+                if (parseNumber(q, end, block) == q) continue;
+                if (!access(block)) return;
+            }
+        }
+        else if (format == "arc")
+        {
+            for (; p < end; p = nextLine(p, end))
+            {
+                uint64_t start;
+                uint64_t count;
+                const char *q = skipBlanks(p, end);
+                const char *r = parseNumber(q, end, start);
+                if (r == q) continue;
+                q = skipBlanks(r, end);
+                if (parseNumber(q, end, count) == q) continue;
+                for (uint64_t block = start; block < start + count; ++block)
+                {
+                    if (!access(block)) return;
+                }
+            }
+        }
+        else if (format == "twitter")
+        {
+            for (; p < end; p = nextLine(p, end))
+            {
+                const char *comma = static_cast<const char *>(memchr(p, ',', static_cast<size_t>(end - p)));
+                if (!comma) return;
+                const char *key = comma + 1;
+                const char *keyEnd = key;
+                while (keyEnd < end && *keyEnd != ',' && *keyEnd != '\n')
+                {
+                    ++keyEnd;
+                }
+                if (!access(MeltiCache::hashBytes(key, static_cast<size_t>(keyEnd - key)))) return;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "unknown trace format: %s\n", format.c_str());
+            exit(2);
+        }
+    }
+
+    struct Job
+    {
+        string policy;
+        size_t capacity;
+        size_t transformNeed;
+        uint64_t requests = 0;
+        uint64_t hits = 0;
+        double seconds = 0.0;
+    };
+
+    unique_ptr<Cache> makeCache(const Job &job)
+    {
+        int cap = static_cast<int>(job.capacity);
+        if (job.policy == "lru") return make_unique<LruCache<Key, Value>>(cap);
+        if (job.policy == "klru") return make_unique<KLruCache<Key, Value>>(cap, cap, 2);
+        if (job.policy == "lfu") return make_unique<LfuCache<Key, Value>>(cap, 10);
+        // ArcCache gives its LRU and LFU parts `capacity` each, half of it keeps ARC on the same size axis
+        if (job.policy == "arc")
+            return make_unique<ArcCache<Key, Value>>(max<size_t>(job.capacity / 2, 1), job.transformNeed);
+        if (job.policy == "clock") return make_unique<ClockCache<Key, Value>>(cap);
+        if (job.policy == "clockpro") return make_unique<ClockProCache<Key, Value>>(cap);
+        if (job.policy == "lirs") return make_unique<LirsCache<Key, Value>>(cap);
+        if (job.policy == "s3fifo") return make_unique<S3FifoCache<Key, Value>>(cap);
+        if (job.policy == "tinylfu") return make_unique<TinyLfuCache<Key, Value>>(cap);
+        fprintf(stderr, "unknown policy: %s\n", job.policy.c_str());
+        exit(2);
+    }
+
+    void replay(const MappedFile &file, const Options &options, Job &job)
+    {
+        unique_ptr<Cache> cache = makeCache(job);
+        auto start = chrono::steady_clock::now();
+        Value value;
+        uint64_t requests = 0;
+        uint64_t hits = 0;
+        forEachRequest(file, options.format, [&](Key key) {
+            if (cache->get(key, value))
+            {
+                ++hits;
+            }
+            else
+            {
+                cache->put(key, 0);
+            }
+            return ++requests != options.limit;
+        });
+        job.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        job.requests = requests;
+        job.hits = hits;
+    }
+
+    void report(const Options &options, const Job &job)
+    {
+        double hitRatio = job.requests ? static_cast<double>(job.hits) / static_cast<double>(job.requests) : 0.0;
+        string label = job.policy == "arc" ? "arc:" + to_string(job.transformNeed) : job.policy;
+        if (options.output == "json")
+        {
+            printf("{\"policy\":\"%s\",\"capacity\":%zu,\"requests\":%llu,\"hits\":%llu,\"hit_ratio\":%.6f,"
+                   "\"seconds\":%.3f}\n",
+                   label.c_str(), job.capacity, static_cast<unsigned long long>(job.requests),
+                   static_cast<unsigned long long>(job.hits), hitRatio, job.seconds);
+        }
+        else
+        {
+            printf("%s,%zu,%llu,%llu,%.6f,%.3f\n", label.c_str(), job.capacity,
+                   static_cast<unsigned long long>(job.requests), static_cast<unsigned long long>(job.hits), hitRatio,
+                   job.seconds);
+        }
+    }
+
+    vector<string> splitList(const string &text)
+    {
+        vector<string> items;
+        stringstream in(text);
+        string item;
+        while (getline(in, item, ','))
+        {
+            if (!item.empty()) items.push_back(item);
+        }
+        return items;
+    }
+
+    vector<size_t> splitNumbers(const string &text)
+    {
+        vector<size_t> numbers;
+        for (const string &item : splitList(text))
+        {
+            numbers.push_back(static_cast<size_t>(stoull(item)));
+        }
+        return numbers;
+    }
+
+    void usage()
+    {
+        fprintf(stderr,
+                "usage: replay --trace=PATH --sizes=N,N,... [--format=arc|lirs|twitter|bin]\n"
+                "              [--policies=lru,klru,lfu,arc,clock,clockpro,lirs,s3fifo,tinylfu] [--transform-need=2,...]\n"
+                "              [--threads=N] [--limit=REQUESTS] [--output=csv|json]\n"
+                "sizes are entry budgets for every policy; arc gets size / 2 per LRU/LFU part\n");
+        exit(2);
+    }
+
+    Options parse(int argc, char **argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; ++i)
+        {
+            string arg = argv[i];
+            size_t eq = arg.find('=');
+            if (arg.compare(0, 2, "--") != 0 || eq == string::npos) usage();
+            string name = arg.substr(2, eq - 2);
+            string value = arg.substr(eq + 1);
+            if (name == "trace") options.trace = value;
+            else if (name == "format") options.format = value;
+            else if (name == "policies") options.policies = splitList(value);
+            else if (name == "sizes") options.sizes = splitNumbers(value);
+            else if (name == "transform-need") options.transformNeeds = splitNumbers(value);
+            else if (name == "threads") options.threads = stoull(value);
+            else if (name == "limit") options.limit = stoull(value);
+            else if (name == "output") options.output = value;
+            else usage();
+        }
+        if (options.trace.empty() || options.sizes.empty() || options.transformNeeds.empty() ||
+            (options.output != "csv" && options.output != "json"))
+        {
+            usage();
+        }
+        if (options.threads == 0) options.threads = max<unsigned>(thread::hardware_concurrency(), 1);
+        return options;
+    }
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    Options options = parse(argc, argv);
+    MappedFile file(options.trace);
+
+    vector<Job> jobs;
+    for (const string &policy : options.policies)
+    {
+        for (size_t capacity : options.sizes)
+        {
+            if (policy != "arc")
+            {
+                jobs.push_back(Job{policy, capacity, 0});
+                continue;
+            }
+            for (size_t transformNeed : options.transformNeeds)
+            {
+                jobs.push_back(Job{policy, capacity, transformNeed});
+            }
+        }
+    }
+
+    // workers pull jobs until none are left, so slow policies do not hold up an idle core
+    atomic<size_t> next{0};
+    vector<thread> workers;
+    for (size_t t = 0; t < min(options.threads, jobs.size()); ++t)
+    {
+        workers.emplace_back([&]() {
+            for (size_t i = next.fetch_add(1); i < jobs.size(); i = next.fetch_add(1))
+            {
+                replay(file, options, jobs[i]);
+            }
+        });
+    }
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    // grouped by policy in the order of --sizes: each group is one hit-ratio curve
+    if (options.output == "csv") printf("policy,capacity,requests,hits,hit_ratio,seconds\n");
+    for (const Job &job : jobs)
+    {
+        report(options, job);
+    }
+    return 0;
+}
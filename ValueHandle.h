@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace MeltiCache
+{
+    // Read-only reference to a cached value returned by ICachePolicy::getHandle().
+    // Pooled policies hand out a pointer straight into the node and pin its slot, so a hit copies nothing;
+    // while the handle lives the node is neither reused nor overwritten (a put to the same key writes a
+    // fresh node instead). Other policies fall back to owning a shared_ptr copy.
+    // A pinned handle must not outlive the cache it came from.
+    template <typename Value>
+    class ValueHandle
+    {
+      public:
+        ValueHandle() = default;
+
+        // caller holds the cache lock that keeps the slot alive while the pin is taken
+        ValueHandle(const Value *value, std::atomic<uint32_t> *pin) : value_(value), pin_(pin)
+        {
+            pin_->fetch_add(1, std::memory_order_relaxed);
+        }
+
+        explicit ValueHandle(std::shared_ptr<const Value> owned) : value_(owned.get()), owned_(std::move(owned)) {}
+
+        ValueHandle(ValueHandle &&other) noexcept
+            : value_(std::exchange(other.value_, nullptr)),
+              pin_(std::exchange(other.pin_, nullptr)),
+              owned_(std::move(other.owned_))
+        {
+        }
+
+        ValueHandle &operator=(ValueHandle &&other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                value_ = std::exchange(other.value_, nullptr);
+                pin_ = std::exchange(other.pin_, nullptr);
+                owned_ = std::move(other.owned_);
+            }
+            return *this;
+        }
+
+        ValueHandle(const ValueHandle &) = delete;
+        ValueHandle &operator=(const ValueHandle &) = delete;
+
+        ~ValueHandle() { reset(); }
+
+        void reset()
+        {
+            if (pin_)
+            {
+                // release: our reads of the value happen before the slot can be reused
+                pin_->fetch_sub(1, std::memory_order_release);
+                pin_ = nullptr;
+            }
+            owned_.reset();
+            value_ = nullptr;
+        }
+
+        explicit operator bool() const { return value_ != nullptr; }
+        const Value &operator*() const { return *value_; }
+        const Value *operator->() const { return value_; }
+        const Value *get() const { return value_; }
+
+      private:
+        const Value *value_ = nullptr;
+        std::atomic<uint32_t> *pin_ = nullptr;
+        std::shared_ptr<const Value> owned_;
+    };
+}  // namespace MeltiCache